@@ -22,6 +22,12 @@ static bool backend_start(struct wlr_backend *wlr_backend) {
 			&output->wlr_output);
 	}
 
+	struct wlr_headless_input_device *device;
+	wl_list_for_each(device, &backend->input_devices, link) {
+		wl_signal_emit_mutable(&backend->backend.events.new_input,
+			headless_input_device_base(device));
+	}
+
 	backend->started = true;
 	return true;
 }
@@ -40,6 +46,11 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 		wlr_output_destroy(&output->wlr_output);
 	}
 
+	struct wlr_headless_input_device *device, *device_tmp;
+	wl_list_for_each_safe(device, device_tmp, &backend->input_devices, link) {
+		destroy_headless_input_device(device);
+	}
+
 	wl_list_remove(&backend->event_loop_destroy.link);
 
 	free(backend);
@@ -76,6 +87,7 @@ struct wlr_backend *wlr_headless_backend_create(struct wl_event_loop *loop) {
 
 	backend->event_loop = loop;
 	wl_list_init(&backend->outputs);
+	wl_list_init(&backend->input_devices);
 
 	backend->event_loop_destroy.notify = handle_event_loop_destroy;
 	wl_event_loop_add_destroy_listener(loop, &backend->event_loop_destroy);
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <wlr/interfaces/wlr_keyboard.h>
+#include <wlr/interfaces/wlr_pointer.h>
+#include <wlr/interfaces/wlr_touch.h>
+#include <wlr/util/log.h>
+#include "backend/headless.h"
+
+static const struct wlr_keyboard_impl keyboard_impl = {
+	.name = "headless-keyboard",
+};
+
+static const struct wlr_pointer_impl pointer_impl = {
+	.name = "headless-pointer",
+};
+
+static const struct wlr_touch_impl touch_impl = {
+	.name = "headless-touch",
+};
+
+static size_t last_input_device_num = 0;
+
+struct wlr_input_device *headless_input_device_base(
+		struct wlr_headless_input_device *device) {
+	switch (device->type) {
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		return &device->keyboard.base;
+	case WLR_INPUT_DEVICE_POINTER:
+		return &device->pointer.base;
+	case WLR_INPUT_DEVICE_TOUCH:
+		return &device->touch.base;
+	default:
+		abort(); // unreachable
+	}
+}
+
+void destroy_headless_input_device(struct wlr_headless_input_device *device) {
+	switch (device->type) {
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		wlr_keyboard_finish(&device->keyboard);
+		break;
+	case WLR_INPUT_DEVICE_POINTER:
+		wlr_pointer_finish(&device->pointer);
+		break;
+	case WLR_INPUT_DEVICE_TOUCH:
+		wlr_touch_finish(&device->touch);
+		break;
+	default:
+		abort(); // unreachable
+	}
+
+	wl_list_remove(&device->link);
+	free(device);
+}
+
+struct wlr_input_device *wlr_headless_add_input_device(
+		struct wlr_backend *wlr_backend, enum wlr_input_device_type type) {
+	struct wlr_headless_backend *backend =
+		headless_backend_from_backend(wlr_backend);
+
+	const char *type_name;
+	switch (type) {
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		type_name = "keyboard";
+		break;
+	case WLR_INPUT_DEVICE_POINTER:
+		type_name = "pointer";
+		break;
+	case WLR_INPUT_DEVICE_TOUCH:
+		type_name = "touch";
+		break;
+	default:
+		wlr_log(WLR_ERROR, "Unsupported headless input device type");
+		return NULL;
+	}
+
+	struct wlr_headless_input_device *device = calloc(1, sizeof(*device));
+	if (device == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate wlr_headless_input_device");
+		return NULL;
+	}
+	device->type = type;
+	device->backend = backend;
+
+	char name[64];
+	snprintf(name, sizeof(name), "headless-%s-%zu", type_name,
+		++last_input_device_num);
+
+	switch (type) {
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		wlr_keyboard_init(&device->keyboard, &keyboard_impl, name);
+		break;
+	case WLR_INPUT_DEVICE_POINTER:
+		wlr_pointer_init(&device->pointer, &pointer_impl, name);
+		break;
+	case WLR_INPUT_DEVICE_TOUCH:
+		wlr_touch_init(&device->touch, &touch_impl, name);
+		break;
+	default:
+		abort(); // unreachable
+	}
+
+	wl_list_insert(&backend->input_devices, &device->link);
+
+	struct wlr_input_device *base = headless_input_device_base(device);
+	if (backend->started) {
+		wl_signal_emit_mutable(&backend->backend.events.new_input, base);
+	}
+
+	return base;
+}
+
+bool wlr_input_device_is_headless(struct wlr_input_device *device) {
+	switch (device->type) {
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		return wlr_keyboard_from_input_device(device)->impl == &keyboard_impl;
+	case WLR_INPUT_DEVICE_POINTER:
+		return wlr_pointer_from_input_device(device)->impl == &pointer_impl;
+	case WLR_INPUT_DEVICE_TOUCH:
+		return wlr_touch_from_input_device(device)->impl == &touch_impl;
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,727 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wlr/interfaces/wlr_keyboard.h>
+#include <wlr/util/log.h>
+#include "backend/headless.h"
+#include "util/time.h"
+
+// Maximum number of events replayed per event loop iteration when replaying
+// as fast as possible
+#define REPLAY_BATCH_LEN 64
+
+struct wlr_headless_recorder_device {
+	struct wlr_headless_input_recorder *recorder;
+	struct wlr_input_device *device;
+	struct wl_list link; // wlr_headless_input_recorder.devices
+
+	struct wl_listener key;
+	struct wl_listener motion;
+	struct wl_listener motion_absolute;
+	struct wl_listener button;
+	struct wl_listener axis;
+	struct wl_listener frame;
+	struct wl_listener touch_down;
+	struct wl_listener touch_up;
+	struct wl_listener touch_motion;
+	struct wl_listener touch_cancel;
+	struct wl_listener touch_frame;
+	struct wl_listener destroy;
+};
+
+static uint64_t get_current_time_usec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now) / 1000;
+}
+
+static bool parse_trace_event(struct wlr_headless_trace_event *event,
+		const char *device, const char *name, const char *args) {
+	if (strcmp(device, "keyboard") == 0) {
+		if (strcmp(name, "key") == 0) {
+			event->type = HEADLESS_TRACE_KEY;
+			return sscanf(args, "%" SCNu32 " %" SCNu32,
+				&event->code, &event->state) == 2;
+		}
+	} else if (strcmp(device, "pointer") == 0) {
+		if (strcmp(name, "motion") == 0) {
+			event->type = HEADLESS_TRACE_POINTER_MOTION;
+			return sscanf(args, "%lf %lf %lf %lf", &event->x, &event->y,
+				&event->unaccel_x, &event->unaccel_y) == 4;
+		} else if (strcmp(name, "motion_absolute") == 0) {
+			event->type = HEADLESS_TRACE_POINTER_MOTION_ABSOLUTE;
+			return sscanf(args, "%lf %lf", &event->x, &event->y) == 2;
+		} else if (strcmp(name, "button") == 0) {
+			event->type = HEADLESS_TRACE_POINTER_BUTTON;
+			return sscanf(args, "%" SCNu32 " %" SCNu32,
+				&event->code, &event->state) == 2;
+		} else if (strcmp(name, "axis") == 0) {
+			event->type = HEADLESS_TRACE_POINTER_AXIS;
+			return sscanf(args, "%" SCNu32 " %" SCNu32 " %lf %" SCNd32,
+				&event->code, &event->state, &event->x, &event->value) == 4;
+		} else if (strcmp(name, "frame") == 0) {
+			event->type = HEADLESS_TRACE_POINTER_FRAME;
+			return true;
+		}
+	} else if (strcmp(device, "touch") == 0) {
+		if (strcmp(name, "down") == 0) {
+			event->type = HEADLESS_TRACE_TOUCH_DOWN;
+			return sscanf(args, "%" SCNd32 " %lf %lf",
+				&event->value, &event->x, &event->y) == 3;
+		} else if (strcmp(name, "up") == 0) {
+			event->type = HEADLESS_TRACE_TOUCH_UP;
+			return sscanf(args, "%" SCNd32, &event->value) == 1;
+		} else if (strcmp(name, "motion") == 0) {
+			event->type = HEADLESS_TRACE_TOUCH_MOTION;
+			return sscanf(args, "%" SCNd32 " %lf %lf",
+				&event->value, &event->x, &event->y) == 3;
+		} else if (strcmp(name, "cancel") == 0) {
+			event->type = HEADLESS_TRACE_TOUCH_CANCEL;
+			return sscanf(args, "%" SCNd32, &event->value) == 1;
+		} else if (strcmp(name, "frame") == 0) {
+			event->type = HEADLESS_TRACE_TOUCH_FRAME;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool parse_trace(FILE *f, struct wl_array *events) {
+	bool ok = true;
+	char *line = NULL;
+	size_t line_size = 0;
+	size_t line_num = 0;
+	uint64_t last_time_usec = 0;
+	while (getline(&line, &line_size, f) >= 0) {
+		line_num++;
+		if (line[0] == '#' || line[0] == '\n' || line[0] == '\0') {
+			continue;
+		}
+
+		struct wlr_headless_trace_event event = {0};
+		char device[16], name[32];
+		int args_offset = 0;
+		if (sscanf(line, "%" SCNu64 " %15s %31s%n", &event.time_usec,
+				device, name, &args_offset) != 3 ||
+				!parse_trace_event(&event, device, name, line + args_offset)) {
+			wlr_log(WLR_ERROR, "Invalid input trace event on line %zu",
+				line_num);
+			ok = false;
+			break;
+		}
+		// Events from different devices may be slightly out of order
+		if (event.time_usec < last_time_usec) {
+			event.time_usec = last_time_usec;
+		}
+		last_time_usec = event.time_usec;
+
+		struct wlr_headless_trace_event *ptr =
+			wl_array_add(events, sizeof(*ptr));
+		if (ptr == NULL) {
+			wlr_log(WLR_ERROR, "Allocation failed");
+			ok = false;
+			break;
+		}
+		*ptr = event;
+	}
+	free(line);
+	return ok;
+}
+
+static enum wlr_input_device_type trace_event_device_type(
+		enum wlr_headless_trace_event_type type) {
+	switch (type) {
+	case HEADLESS_TRACE_KEY:
+		return WLR_INPUT_DEVICE_KEYBOARD;
+	case HEADLESS_TRACE_POINTER_MOTION:
+	case HEADLESS_TRACE_POINTER_MOTION_ABSOLUTE:
+	case HEADLESS_TRACE_POINTER_BUTTON:
+	case HEADLESS_TRACE_POINTER_AXIS:
+	case HEADLESS_TRACE_POINTER_FRAME:
+		return WLR_INPUT_DEVICE_POINTER;
+	case HEADLESS_TRACE_TOUCH_DOWN:
+	case HEADLESS_TRACE_TOUCH_UP:
+	case HEADLESS_TRACE_TOUCH_MOTION:
+	case HEADLESS_TRACE_TOUCH_CANCEL:
+	case HEADLESS_TRACE_TOUCH_FRAME:
+		return WLR_INPUT_DEVICE_TOUCH;
+	}
+	abort(); // unreachable
+}
+
+static void replay_emit_event(struct wlr_headless_input_replay *replay,
+		const struct wlr_headless_trace_event *trace_event, uint64_t time_usec) {
+	uint32_t time_msec = time_usec / 1000;
+
+	switch (trace_event->type) {
+	case HEADLESS_TRACE_KEY:;
+		struct wlr_keyboard_key_event key = {
+			.time_msec = time_msec,
+			.time_usec = time_usec,
+			.keycode = trace_event->code,
+			.update_state = true,
+			.state = trace_event->state,
+		};
+		wlr_keyboard_notify_key(replay->keyboard, &key);
+		break;
+	case HEADLESS_TRACE_POINTER_MOTION:;
+		struct wlr_pointer_motion_event motion = {
+			.pointer = replay->pointer,
+			.time_msec = time_msec,
+			.time_usec = time_usec,
+			.delta_x = trace_event->x,
+			.delta_y = trace_event->y,
+			.unaccel_dx = trace_event->unaccel_x,
+			.unaccel_dy = trace_event->unaccel_y,
+		};
+		wl_signal_emit_mutable(&replay->pointer->events.motion, &motion);
+		break;
+	case HEADLESS_TRACE_POINTER_MOTION_ABSOLUTE:;
+		struct wlr_pointer_motion_absolute_event motion_absolute = {
+			.pointer = replay->pointer,
+			.time_msec = time_msec,
+			.time_usec = time_usec,
+			.x = trace_event->x,
+			.y = trace_event->y,
+		};
+		wl_signal_emit_mutable(&replay->pointer->events.motion_absolute,
+			&motion_absolute);
+		break;
+	case HEADLESS_TRACE_POINTER_BUTTON:;
+		struct wlr_pointer_button_event button = {
+			.pointer = replay->pointer,
+			.time_msec = time_msec,
+			.time_usec = time_usec,
+			.button = trace_event->code,
+			.state = trace_event->state,
+		};
+		wl_signal_emit_mutable(&replay->pointer->events.button, &button);
+		break;
+	case HEADLESS_TRACE_POINTER_AXIS:;
+		struct wlr_pointer_axis_event axis = {
+			.pointer = replay->pointer,
+			.time_msec = time_msec,
+			.time_usec = time_usec,
+			.source = trace_event->code,
+			.orientation = trace_event->state,
+			.relative_direction = WL_POINTER_AXIS_RELATIVE_DIRECTION_IDENTICAL,
+			.delta = trace_event->x,
+			.delta_discrete = trace_event->value,
+		};
+		wl_signal_emit_mutable(&replay->pointer->events.axis, &axis);
+		break;
+	case HEADLESS_TRACE_POINTER_FRAME:
+		wl_signal_emit_mutable(&replay->pointer->events.frame, replay->pointer);
+		break;
+	case HEADLESS_TRACE_TOUCH_DOWN:;
+		struct wlr_touch_down_event down = {
+			.touch = replay->touch,
+			.time_msec = time_msec,
+			.time_usec = time_usec,
+			.touch_id = trace_event->value,
+			.x = trace_event->x,
+			.y = trace_event->y,
+		};
+		wl_signal_emit_mutable(&replay->touch->events.down, &down);
+		break;
+	case HEADLESS_TRACE_TOUCH_UP:;
+		struct wlr_touch_up_event up = {
+			.touch = replay->touch,
+			.time_msec = time_msec,
+			.time_usec = time_usec,
+			.touch_id = trace_event->value,
+		};
+		wl_signal_emit_mutable(&replay->touch->events.up, &up);
+		break;
+	case HEADLESS_TRACE_TOUCH_MOTION:;
+		struct wlr_touch_motion_event touch_motion = {
+			.touch = replay->touch,
+			.time_msec = time_msec,
+			.time_usec = time_usec,
+			.touch_id = trace_event->value,
+			.x = trace_event->x,
+			.y = trace_event->y,
+		};
+		wl_signal_emit_mutable(&replay->touch->events.motion, &touch_motion);
+		break;
+	case HEADLESS_TRACE_TOUCH_CANCEL:;
+		struct wlr_touch_cancel_event cancel = {
+			.touch = replay->touch,
+			.time_msec = time_msec,
+			.time_usec = time_usec,
+			.touch_id = trace_event->value,
+		};
+		wl_signal_emit_mutable(&replay->touch->events.cancel, &cancel);
+		break;
+	case HEADLESS_TRACE_TOUCH_FRAME:
+		wl_signal_emit_mutable(&replay->touch->events.frame, NULL);
+		break;
+	}
+}
+
+static int replay_handle_timer(void *data) {
+	struct wlr_headless_input_replay *replay = data;
+
+	const struct wlr_headless_trace_event *trace_events =
+		replay->trace_events.data;
+	size_t trace_events_len =
+		replay->trace_events.size / sizeof(trace_events[0]);
+
+	uint64_t now_usec = get_current_time_usec();
+	uint64_t next_usec = now_usec;
+	size_t n_emitted = 0;
+	while (replay->next_event < trace_events_len) {
+		const struct wlr_headless_trace_event *trace_event =
+			&trace_events[replay->next_event];
+
+		uint64_t time_usec = now_usec;
+		if (replay->speed > 0) {
+			uint64_t offset_usec =
+				trace_event->time_usec - trace_events[0].time_usec;
+			time_usec = replay->start_usec +
+				(uint64_t)(offset_usec / replay->speed);
+			if (time_usec > now_usec) {
+				next_usec = time_usec;
+				break;
+			}
+		} else if (n_emitted == REPLAY_BATCH_LEN) {
+			break;
+		}
+
+		replay->next_event++;
+		n_emitted++;
+		replay_emit_event(replay, trace_event, time_usec);
+	}
+
+	if (replay->next_event == trace_events_len) {
+		wl_event_source_timer_update(replay->timer, 0);
+		wl_signal_emit_mutable(&replay->events.done, NULL);
+		return 0;
+	}
+
+	int delay_ms = (next_usec - now_usec + 999) / 1000;
+	if (delay_ms < 1) {
+		delay_ms = 1;
+	}
+	wl_event_source_timer_update(replay->timer, delay_ms);
+	return 0;
+}
+
+static void replay_handle_backend_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_headless_input_replay *replay =
+		wl_container_of(listener, replay, backend_destroy);
+	wlr_headless_input_replay_destroy(replay);
+}
+
+static bool replay_ensure_device(struct wlr_headless_input_replay *replay,
+		enum wlr_input_device_type type) {
+	struct wlr_input_device *device;
+	switch (type) {
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		if (replay->keyboard != NULL) {
+			return true;
+		}
+		device = wlr_headless_add_input_device(replay->backend, type);
+		if (device == NULL) {
+			return false;
+		}
+		replay->keyboard = wlr_keyboard_from_input_device(device);
+		return true;
+	case WLR_INPUT_DEVICE_POINTER:
+		if (replay->pointer != NULL) {
+			return true;
+		}
+		device = wlr_headless_add_input_device(replay->backend, type);
+		if (device == NULL) {
+			return false;
+		}
+		replay->pointer = wlr_pointer_from_input_device(device);
+		return true;
+	case WLR_INPUT_DEVICE_TOUCH:
+		if (replay->touch != NULL) {
+			return true;
+		}
+		device = wlr_headless_add_input_device(replay->backend, type);
+		if (device == NULL) {
+			return false;
+		}
+		replay->touch = wlr_touch_from_input_device(device);
+		return true;
+	default:
+		abort(); // unreachable
+	}
+}
+
+/**
+ * Destroy the input devices created for a replay.
+ */
+static void replay_destroy_devices(struct wlr_headless_input_replay *replay) {
+	struct wlr_headless_input_device *device;
+	if (replay->keyboard != NULL) {
+		device = wl_container_of(replay->keyboard, device, keyboard);
+		destroy_headless_input_device(device);
+	}
+	if (replay->pointer != NULL) {
+		device = wl_container_of(replay->pointer, device, pointer);
+		destroy_headless_input_device(device);
+	}
+	if (replay->touch != NULL) {
+		device = wl_container_of(replay->touch, device, touch);
+		destroy_headless_input_device(device);
+	}
+}
+
+struct wlr_headless_input_replay *wlr_headless_input_replay_create(
+		struct wlr_backend *wlr_backend, int fd, double speed) {
+	struct wlr_headless_backend *backend =
+		headless_backend_from_backend(wlr_backend);
+
+	if (speed < 0) {
+		wlr_log(WLR_ERROR, "Invalid input replay speed");
+		return NULL;
+	}
+
+	int dup_fd = dup(fd);
+	if (dup_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "dup failed");
+		return NULL;
+	}
+	FILE *f = fdopen(dup_fd, "r");
+	if (f == NULL) {
+		wlr_log_errno(WLR_ERROR, "fdopen failed");
+		close(dup_fd);
+		return NULL;
+	}
+
+	struct wlr_headless_input_replay *replay = calloc(1, sizeof(*replay));
+	if (replay == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		fclose(f);
+		return NULL;
+	}
+	replay->backend = wlr_backend;
+	replay->speed = speed;
+	wl_array_init(&replay->trace_events);
+
+	bool ok = parse_trace(f, &replay->trace_events);
+	fclose(f);
+	if (!ok) {
+		goto error;
+	}
+
+	const struct wlr_headless_trace_event *trace_event;
+	wl_array_for_each(trace_event, &replay->trace_events) {
+		if (!replay_ensure_device(replay,
+				trace_event_device_type(trace_event->type))) {
+			goto error;
+		}
+	}
+
+	replay->timer = wl_event_loop_add_timer(backend->event_loop,
+		replay_handle_timer, replay);
+	if (replay->timer == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create timer");
+		goto error;
+	}
+
+	wl_signal_init(&replay->events.done);
+	wl_signal_init(&replay->events.destroy);
+
+	replay->backend_destroy.notify = replay_handle_backend_destroy;
+	wl_signal_add(&wlr_backend->events.destroy, &replay->backend_destroy);
+
+	replay->start_usec = get_current_time_usec();
+	wl_event_source_timer_update(replay->timer, 1);
+
+	return replay;
+
+error:
+	replay_destroy_devices(replay);
+	wl_array_release(&replay->trace_events);
+	free(replay);
+	return NULL;
+}
+
+void wlr_headless_input_replay_destroy(struct wlr_headless_input_replay *replay) {
+	if (replay == NULL) {
+		return;
+	}
+
+	wl_signal_emit_mutable(&replay->events.destroy, NULL);
+	assert(wl_list_empty(&replay->events.destroy.listener_list));
+
+	replay_destroy_devices(replay);
+	wl_event_source_remove(replay->timer);
+	wl_list_remove(&replay->backend_destroy.link);
+	wl_array_release(&replay->trace_events);
+	free(replay);
+}
+
+static uint64_t event_time_usec(struct wlr_headless_input_recorder *recorder,
+		uint32_t time_msec, uint64_t time_usec) {
+	if (time_usec == 0) {
+		time_usec = (uint64_t)time_msec * 1000;
+	}
+	recorder->last_time_usec = time_usec;
+	return time_usec;
+}
+
+static void recorder_handle_key(struct wl_listener *listener, void *data) {
+	struct wlr_headless_recorder_device *device =
+		wl_container_of(listener, device, key);
+	struct wlr_keyboard_key_event *event = data;
+	fprintf(device->recorder->file, "%" PRIu64 " keyboard key %" PRIu32 " %d\n",
+		event_time_usec(device->recorder, event->time_msec, event->time_usec),
+		event->keycode, (int)event->state);
+}
+
+static void recorder_handle_motion(struct wl_listener *listener, void *data) {
+	struct wlr_headless_recorder_device *device =
+		wl_container_of(listener, device, motion);
+	struct wlr_pointer_motion_event *event = data;
+	fprintf(device->recorder->file,
+		"%" PRIu64 " pointer motion %.9g %.9g %.9g %.9g\n",
+		event_time_usec(device->recorder, event->time_msec, event->time_usec),
+		event->delta_x, event->delta_y, event->unaccel_dx, event->unaccel_dy);
+}
+
+static void recorder_handle_motion_absolute(struct wl_listener *listener,
+		void *data) {
+	struct wlr_headless_recorder_device *device =
+		wl_container_of(listener, device, motion_absolute);
+	struct wlr_pointer_motion_absolute_event *event = data;
+	fprintf(device->recorder->file,
+		"%" PRIu64 " pointer motion_absolute %.9g %.9g\n",
+		event_time_usec(device->recorder, event->time_msec, event->time_usec),
+		event->x, event->y);
+}
+
+static void recorder_handle_button(struct wl_listener *listener, void *data) {
+	struct wlr_headless_recorder_device *device =
+		wl_container_of(listener, device, button);
+	struct wlr_pointer_button_event *event = data;
+	fprintf(device->recorder->file,
+		"%" PRIu64 " pointer button %" PRIu32 " %d\n",
+		event_time_usec(device->recorder, event->time_msec, event->time_usec),
+		event->button, (int)event->state);
+}
+
+static void recorder_handle_axis(struct wl_listener *listener, void *data) {
+	struct wlr_headless_recorder_device *device =
+		wl_container_of(listener, device, axis);
+	struct wlr_pointer_axis_event *event = data;
+	fprintf(device->recorder->file,
+		"%" PRIu64 " pointer axis %d %d %.9g %" PRId32 "\n",
+		event_time_usec(device->recorder, event->time_msec, event->time_usec),
+		(int)event->source, (int)event->orientation, event->delta,
+		event->delta_discrete);
+}
+
+static void recorder_handle_frame(struct wl_listener *listener, void *data) {
+	struct wlr_headless_recorder_device *device =
+		wl_container_of(listener, device, frame);
+	// Frame events don't carry a timestamp
+	fprintf(device->recorder->file, "%" PRIu64 " pointer frame\n",
+		device->recorder->last_time_usec);
+}
+
+static void recorder_handle_touch_down(struct wl_listener *listener,
+		void *data) {
+	struct wlr_headless_recorder_device *device =
+		wl_container_of(listener, device, touch_down);
+	struct wlr_touch_down_event *event = data;
+	fprintf(device->recorder->file,
+		"%" PRIu64 " touch down %" PRId32 " %.9g %.9g\n",
+		event_time_usec(device->recorder, event->time_msec, event->time_usec),
+		event->touch_id, event->x, event->y);
+}
+
+static void recorder_handle_touch_up(struct wl_listener *listener, void *data) {
+	struct wlr_headless_recorder_device *device =
+		wl_container_of(listener, device, touch_up);
+	struct wlr_touch_up_event *event = data;
+	fprintf(device->recorder->file, "%" PRIu64 " touch up %" PRId32 "\n",
+		event_time_usec(device->recorder, event->time_msec, event->time_usec),
+		event->touch_id);
+}
+
+static void recorder_handle_touch_motion(struct wl_listener *listener,
+		void *data) {
+	struct wlr_headless_recorder_device *device =
+		wl_container_of(listener, device, touch_motion);
+	struct wlr_touch_motion_event *event = data;
+	fprintf(device->recorder->file,
+		"%" PRIu64 " touch motion %" PRId32 " %.9g %.9g\n",
+		event_time_usec(device->recorder, event->time_msec, event->time_usec),
+		event->touch_id, event->x, event->y);
+}
+
+static void recorder_handle_touch_cancel(struct wl_listener *listener,
+		void *data) {
+	struct wlr_headless_recorder_device *device =
+		wl_container_of(listener, device, touch_cancel);
+	struct wlr_touch_cancel_event *event = data;
+	fprintf(device->recorder->file, "%" PRIu64 " touch cancel %" PRId32 "\n",
+		event_time_usec(device->recorder, event->time_msec, event->time_usec),
+		event->touch_id);
+}
+
+static void recorder_handle_touch_frame(struct wl_listener *listener,
+		void *data) {
+	struct wlr_headless_recorder_device *device =
+		wl_container_of(listener, device, touch_frame);
+	fprintf(device->recorder->file, "%" PRIu64 " touch frame\n",
+		device->recorder->last_time_usec);
+}
+
+static void recorder_device_destroy(
+		struct wlr_headless_recorder_device *device) {
+	switch (device->device->type) {
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		wl_list_remove(&device->key.link);
+		break;
+	case WLR_INPUT_DEVICE_POINTER:
+		wl_list_remove(&device->motion.link);
+		wl_list_remove(&device->motion_absolute.link);
+		wl_list_remove(&device->button.link);
+		wl_list_remove(&device->axis.link);
+		wl_list_remove(&device->frame.link);
+		break;
+	case WLR_INPUT_DEVICE_TOUCH:
+		wl_list_remove(&device->touch_down.link);
+		wl_list_remove(&device->touch_up.link);
+		wl_list_remove(&device->touch_motion.link);
+		wl_list_remove(&device->touch_cancel.link);
+		wl_list_remove(&device->touch_frame.link);
+		break;
+	default:
+		abort(); // unreachable
+	}
+	wl_list_remove(&device->destroy.link);
+	wl_list_remove(&device->link);
+	free(device);
+}
+
+static void recorder_handle_device_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_headless_recorder_device *device =
+		wl_container_of(listener, device, destroy);
+	recorder_device_destroy(device);
+}
+
+struct wlr_headless_input_recorder *wlr_headless_input_recorder_create(int fd) {
+	int dup_fd = dup(fd);
+	if (dup_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "dup failed");
+		return NULL;
+	}
+	FILE *f = fdopen(dup_fd, "w");
+	if (f == NULL) {
+		wlr_log_errno(WLR_ERROR, "fdopen failed");
+		close(dup_fd);
+		return NULL;
+	}
+
+	struct wlr_headless_input_recorder *recorder = calloc(1, sizeof(*recorder));
+	if (recorder == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		fclose(f);
+		return NULL;
+	}
+
+	recorder->file = f;
+	wl_list_init(&recorder->devices);
+	wl_signal_init(&recorder->events.destroy);
+
+	fprintf(f, "# wlroots input trace\n");
+
+	return recorder;
+}
+
+void wlr_headless_input_recorder_destroy(
+		struct wlr_headless_input_recorder *recorder) {
+	if (recorder == NULL) {
+		return;
+	}
+
+	wl_signal_emit_mutable(&recorder->events.destroy, NULL);
+
+	struct wlr_headless_recorder_device *device, *tmp;
+	wl_list_for_each_safe(device, tmp, &recorder->devices, link) {
+		recorder_device_destroy(device);
+	}
+
+	fclose(recorder->file);
+	free(recorder);
+}
+
+bool wlr_headless_input_recorder_add_device(
+		struct wlr_headless_input_recorder *recorder,
+		struct wlr_input_device *wlr_device) {
+	switch (wlr_device->type) {
+	case WLR_INPUT_DEVICE_KEYBOARD:
+	case WLR_INPUT_DEVICE_POINTER:
+	case WLR_INPUT_DEVICE_TOUCH:
+		break;
+	default:
+		wlr_log(WLR_ERROR, "Unsupported input device type for recording");
+		return false;
+	}
+
+	struct wlr_headless_recorder_device *device = calloc(1, sizeof(*device));
+	if (device == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	device->recorder = recorder;
+	device->device = wlr_device;
+
+	switch (wlr_device->type) {
+	case WLR_INPUT_DEVICE_KEYBOARD:;
+		struct wlr_keyboard *keyboard =
+			wlr_keyboard_from_input_device(wlr_device);
+		device->key.notify = recorder_handle_key;
+		wl_signal_add(&keyboard->events.key, &device->key);
+		break;
+	case WLR_INPUT_DEVICE_POINTER:;
+		struct wlr_pointer *pointer = wlr_pointer_from_input_device(wlr_device);
+		device->motion.notify = recorder_handle_motion;
+		wl_signal_add(&pointer->events.motion, &device->motion);
+		device->motion_absolute.notify = recorder_handle_motion_absolute;
+		wl_signal_add(&pointer->events.motion_absolute,
+			&device->motion_absolute);
+		device->button.notify = recorder_handle_button;
+		wl_signal_add(&pointer->events.button, &device->button);
+		device->axis.notify = recorder_handle_axis;
+		wl_signal_add(&pointer->events.axis, &device->axis);
+		device->frame.notify = recorder_handle_frame;
+		wl_signal_add(&pointer->events.frame, &device->frame);
+		break;
+	case WLR_INPUT_DEVICE_TOUCH:;
+		struct wlr_touch *touch = wlr_touch_from_input_device(wlr_device);
+		device->touch_down.notify = recorder_handle_touch_down;
+		wl_signal_add(&touch->events.down, &device->touch_down);
+		device->touch_up.notify = recorder_handle_touch_up;
+		wl_signal_add(&touch->events.up, &device->touch_up);
+		device->touch_motion.notify = recorder_handle_touch_motion;
+		wl_signal_add(&touch->events.motion, &device->touch_motion);
+		device->touch_cancel.notify = recorder_handle_touch_cancel;
+		wl_signal_add(&touch->events.cancel, &device->touch_cancel);
+		device->touch_frame.notify = recorder_handle_touch_frame;
+		wl_signal_add(&touch->events.frame, &device->touch_frame);
+		break;
+	default:
+		abort(); // unreachable
+	}
+
+	device->destroy.notify = recorder_handle_device_destroy;
+	wl_signal_add(&wlr_device->events.destroy, &device->destroy);
+
+	wl_list_insert(&recorder->devices, &device->link);
+	return true;
+}
@@ -46,22 +46,101 @@ static const struct libinput_interface libinput_impl = {
 	.close_restricted = libinput_close_restricted
 };
 
-static int handle_libinput_readable(int fd, uint32_t mask, void *_backend) {
-	struct wlr_libinput_backend *backend = _backend;
+/**
+ * Read events from the kernel into the libinput queue. Returns false if the
+ * backend has been destroyed.
+ */
+static bool dispatch_libinput(struct wlr_libinput_backend *backend) {
 	int ret = libinput_dispatch(backend->libinput_context);
 	if (ret != 0) {
 		wlr_log(WLR_ERROR, "Failed to dispatch libinput: %s", strerror(-ret));
 		wlr_backend_destroy(&backend->backend);
-		return 0;
+		return false;
 	}
+	return true;
+}
+
+static void handle_queued_events(struct wlr_libinput_backend *backend) {
 	struct libinput_event *event;
 	while ((event = libinput_get_event(backend->libinput_context))) {
 		handle_libinput_event(backend, event);
 		libinput_event_destroy(event);
 	}
+	if (backend->motion_coalescing.pending &&
+			backend->motion_coalescing.max_delay_usec == 0) {
+		flush_coalesced_motion(backend);
+	}
+}
+
+static int handle_libinput_readable(int fd, uint32_t mask, void *_backend) {
+	struct wlr_libinput_backend *backend = _backend;
+	if (!dispatch_libinput(backend)) {
+		return 0;
+	}
+	handle_queued_events(backend);
+	return 0;
+}
+
+static void handle_queued_events_idle(void *data) {
+	struct wlr_libinput_backend *backend = data;
+	backend->queued_events_idle = NULL;
+	handle_queued_events(backend);
+}
+
+void flush_coalesced_motion(struct wlr_libinput_backend *backend) {
+	if (!backend->motion_coalescing.pending) {
+		return;
+	}
+	backend->motion_coalescing.pending = false;
+	backend->motion_coalescing.device = NULL;
+	if (backend->motion_coalescing.timer != NULL) {
+		wl_event_source_timer_update(backend->motion_coalescing.timer, 0);
+	}
+
+	struct wlr_libinput_input_device *dev;
+	wl_list_for_each(dev, &backend->devices, link) {
+		if (dev->pointer.impl != NULL) {
+			flush_pointer_motion(&dev->pointer);
+		}
+	}
+}
+
+static int handle_motion_coalescing_timer(void *data) {
+	struct wlr_libinput_backend *backend = data;
+	flush_coalesced_motion(backend);
 	return 0;
 }
 
+bool coalesce_pointer_motion(struct wlr_libinput_backend *backend,
+		struct libinput_event *event) {
+	if (!backend->motion_coalescing.enabled) {
+		return false;
+	}
+
+	struct libinput_event_pointer *pevent =
+		libinput_event_get_pointer_event(event);
+	uint64_t time_usec = libinput_event_pointer_get_time_usec(pevent);
+	uint32_t max_delay_usec = backend->motion_coalescing.max_delay_usec;
+
+	if (backend->motion_coalescing.pending && max_delay_usec > 0 &&
+			time_usec - backend->motion_coalescing.first_time_usec >= max_delay_usec) {
+		flush_coalesced_motion(backend);
+	}
+
+	if (!backend->motion_coalescing.pending) {
+		backend->motion_coalescing.pending = true;
+		backend->motion_coalescing.device = libinput_device_get_user_data(
+			libinput_event_get_device(event));
+		backend->motion_coalescing.first_time_usec = time_usec;
+		if (backend->motion_coalescing.timer != NULL) {
+			wl_event_source_timer_update(backend->motion_coalescing.timer,
+				(max_delay_usec + 999) / 1000);
+		}
+	}
+
+	return true;
+}
+
 static enum wlr_log_importance libinput_log_priority_to_wlr(
 		enum libinput_log_priority priority) {
 	switch (priority) {
@@ -135,6 +214,13 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 	struct wlr_libinput_backend *backend =
 		get_libinput_backend_from_backend(wlr_backend);
 
+	if (backend->motion_coalescing.timer != NULL) {
+		wl_event_source_remove(backend->motion_coalescing.timer);
+	}
+	if (backend->queued_events_idle != NULL) {
+		wl_event_source_remove(backend->queued_events_idle);
+	}
+
 	struct wlr_libinput_input_device *dev, *tmp;
 	wl_list_for_each_safe(dev, tmp, &backend->devices, link) {
 		destroy_libinput_input_device(dev);
@@ -230,6 +316,61 @@ struct libinput_device *wlr_libinput_get_device_handle(
 	return dev->handle;
 }
 
+void wlr_libinput_backend_set_motion_coalescing(struct wlr_backend *wlr_backend,
+		bool enabled, uint32_t max_delay_usec) {
+	struct wlr_libinput_backend *backend =
+		get_libinput_backend_from_backend(wlr_backend);
+
+	flush_coalesced_motion(backend);
+
+	backend->motion_coalescing.enabled = enabled;
+	backend->motion_coalescing.max_delay_usec = enabled ? max_delay_usec : 0;
+
+	bool needs_timer = enabled && max_delay_usec > 0;
+	if (needs_timer && backend->motion_coalescing.timer == NULL) {
+		backend->motion_coalescing.timer =
+			wl_event_loop_add_timer(backend->session->event_loop,
+			handle_motion_coalescing_timer, backend);
+		if (backend->motion_coalescing.timer == NULL) {
+			wlr_log(WLR_ERROR, "Failed to create motion coalescing timer, "
+				"flushing motion after each read");
+			backend->motion_coalescing.max_delay_usec = 0;
+		}
+	} else if (!needs_timer && backend->motion_coalescing.timer != NULL) {
+		wl_event_source_remove(backend->motion_coalescing.timer);
+		backend->motion_coalescing.timer = NULL;
+	}
+}
+
+void wlr_libinput_backend_read_events(struct wlr_backend *wlr_backend) {
+	struct wlr_libinput_backend *backend =
+		get_libinput_backend_from_backend(wlr_backend);
+	if (backend->libinput_context == NULL) {
+		return;
+	}
+
+	if (!dispatch_libinput(backend)) {
+		return;
+	}
+
+	// The libinput FD has been drained, make sure the queued events still
+	// get processed
+	if (libinput_next_event_type(backend->libinput_context) != LIBINPUT_EVENT_NONE &&
+			backend->queued_events_idle == NULL) {
+		backend->queued_events_idle = wl_event_loop_add_idle(
+			backend->session->event_loop, handle_queued_events_idle, backend);
+		if (backend->queued_events_idle == NULL) {
+			wlr_log(WLR_ERROR, "Failed to create idle event source");
+		}
+	}
+}
+
+void wlr_libinput_backend_flush_motion(struct wlr_backend *wlr_backend) {
+	struct wlr_libinput_backend *backend =
+		get_libinput_backend_from_backend(wlr_backend);
+	flush_coalesced_motion(backend);
+}
+
 uint32_t usec_to_msec(uint64_t usec) {
 	return (uint32_t)(usec / 1000);
 }
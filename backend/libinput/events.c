@@ -142,6 +142,15 @@ void handle_libinput_event(struct wlr_libinput_backend *backend,
 		libinput_device_get_user_data(libinput_dev);
 	enum libinput_event_type event_type = libinput_event_get_type(event);
 
+	// Preserve ordering of coalesced motion with respect to other events,
+	// including motion of other devices
+	if (backend->motion_coalescing.pending &&
+			((event_type != LIBINPUT_EVENT_POINTER_MOTION &&
+			event_type != LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE) ||
+			dev != backend->motion_coalescing.device)) {
+		flush_coalesced_motion(backend);
+	}
+
 	if (dev == NULL && event_type != LIBINPUT_EVENT_DEVICE_ADDED) {
 		wlr_log(WLR_ERROR, "libinput_device has no wlr_libinput_input_device");
 		return;
@@ -158,10 +167,12 @@ void handle_libinput_event(struct wlr_libinput_backend *backend,
 		handle_keyboard_key(event, &dev->keyboard);
 		break;
 	case LIBINPUT_EVENT_POINTER_MOTION:
-		handle_pointer_motion(event, &dev->pointer);
+		handle_pointer_motion(event, &dev->pointer,
+			coalesce_pointer_motion(backend, event));
 		break;
 	case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
-		handle_pointer_motion_abs(event, &dev->pointer);
+		handle_pointer_motion_abs(event, &dev->pointer,
+			coalesce_pointer_motion(backend, event));
 		break;
 	case LIBINPUT_EVENT_POINTER_BUTTON:
 		handle_pointer_button(event, &dev->pointer);
@@ -36,6 +36,7 @@ void handle_keyboard_key(struct libinput_event *event,
 		libinput_event_get_keyboard_event(event);
 	struct wlr_keyboard_key_event wlr_event = {
 		.time_msec = usec_to_msec(libinput_event_keyboard_get_time_usec(kbevent)),
+		.time_usec = libinput_event_keyboard_get_time_usec(kbevent),
 		.keycode = libinput_event_keyboard_get_key(kbevent),
 		.update_state = true,
 	};
@@ -22,34 +22,85 @@ struct wlr_libinput_input_device *device_from_pointer(
 	return dev;
 }
 
+void flush_pointer_motion(struct wlr_pointer *pointer) {
+	struct wlr_libinput_input_device *dev = device_from_pointer(pointer);
+
+	if (dev->pending_motion.has_motion) {
+		dev->pending_motion.has_motion = false;
+		wl_signal_emit_mutable(&pointer->events.motion,
+			&dev->pending_motion.motion);
+		wl_signal_emit_mutable(&pointer->events.frame, pointer);
+	}
+	if (dev->pending_motion.has_motion_absolute) {
+		dev->pending_motion.has_motion_absolute = false;
+		wl_signal_emit_mutable(&pointer->events.motion_absolute,
+			&dev->pending_motion.motion_absolute);
+		wl_signal_emit_mutable(&pointer->events.frame, pointer);
+	}
+}
+
 void handle_pointer_motion(struct libinput_event *event,
-		struct wlr_pointer *pointer) {
+		struct wlr_pointer *pointer, bool coalesce) {
 	struct libinput_event_pointer *pevent =
 		libinput_event_get_pointer_event(event);
 	struct wlr_pointer_motion_event wlr_event = {
 		.pointer = pointer,
 		.time_msec = usec_to_msec(libinput_event_pointer_get_time_usec(pevent)),
+		.time_usec = libinput_event_pointer_get_time_usec(pevent),
 		.delta_x = libinput_event_pointer_get_dx(pevent),
 		.delta_y = libinput_event_pointer_get_dy(pevent),
 		.unaccel_dx = libinput_event_pointer_get_dx_unaccelerated(pevent),
 		.unaccel_dy = libinput_event_pointer_get_dy_unaccelerated(pevent),
 	};
-	wl_signal_emit_mutable(&pointer->events.motion, &wlr_event);
-	wl_signal_emit_mutable(&pointer->events.frame, pointer);
+	if (!coalesce) {
+		wl_signal_emit_mutable(&pointer->events.motion, &wlr_event);
+		wl_signal_emit_mutable(&pointer->events.frame, pointer);
+		return;
+	}
+
+	struct wlr_libinput_input_device *dev = device_from_pointer(pointer);
+	if (dev->pending_motion.has_motion_absolute) {
+		flush_pointer_motion(pointer);
+	}
+
+	struct wlr_pointer_motion_event *pending = &dev->pending_motion.motion;
+	if (dev->pending_motion.has_motion) {
+		pending->time_msec = wlr_event.time_msec;
+		pending->time_usec = wlr_event.time_usec;
+		pending->delta_x += wlr_event.delta_x;
+		pending->delta_y += wlr_event.delta_y;
+		pending->unaccel_dx += wlr_event.unaccel_dx;
+		pending->unaccel_dy += wlr_event.unaccel_dy;
+	} else {
+		*pending = wlr_event;
+		dev->pending_motion.has_motion = true;
+	}
 }
 
 void handle_pointer_motion_abs(struct libinput_event *event,
-		struct wlr_pointer *pointer) {
+		struct wlr_pointer *pointer, bool coalesce) {
 	struct libinput_event_pointer *pevent =
 		libinput_event_get_pointer_event(event);
 	struct wlr_pointer_motion_absolute_event wlr_event = {
 		.pointer = pointer,
 		.time_msec = usec_to_msec(libinput_event_pointer_get_time_usec(pevent)),
+		.time_usec = libinput_event_pointer_get_time_usec(pevent),
 		.x = libinput_event_pointer_get_absolute_x_transformed(pevent, 1),
 		.y = libinput_event_pointer_get_absolute_y_transformed(pevent, 1),
 	};
-	wl_signal_emit_mutable(&pointer->events.motion_absolute, &wlr_event);
-	wl_signal_emit_mutable(&pointer->events.frame, pointer);
+	if (!coalesce) {
+		wl_signal_emit_mutable(&pointer->events.motion_absolute, &wlr_event);
+		wl_signal_emit_mutable(&pointer->events.frame, pointer);
+		return;
+	}
+
+	struct wlr_libinput_input_device *dev = device_from_pointer(pointer);
+	if (dev->pending_motion.has_motion) {
+		flush_pointer_motion(pointer);
+	}
+
+	dev->pending_motion.motion_absolute = wlr_event;
+	dev->pending_motion.has_motion_absolute = true;
 }
 
 void handle_pointer_button(struct libinput_event *event,
@@ -59,6 +110,7 @@ void handle_pointer_button(struct libinput_event *event,
 	struct wlr_pointer_button_event wlr_event = {
 		.pointer = pointer,
 		.time_msec = usec_to_msec(libinput_event_pointer_get_time_usec(pevent)),
+		.time_usec = libinput_event_pointer_get_time_usec(pevent),
 		.button = libinput_event_pointer_get_button(pevent),
 	};
 	// Ignore events which aren't a seat-wide state change. For instance, if
@@ -90,6 +142,7 @@ void handle_pointer_axis(struct libinput_event *event,
 	struct wlr_pointer_axis_event wlr_event = {
 		.pointer = pointer,
 		.time_msec = usec_to_msec(libinput_event_pointer_get_time_usec(pevent)),
+		.time_usec = libinput_event_pointer_get_time_usec(pevent),
 	};
 	switch (libinput_event_pointer_get_axis_source(pevent)) {
 	case LIBINPUT_POINTER_AXIS_SOURCE_WHEEL:
@@ -144,6 +197,7 @@ void handle_pointer_axis_value120(struct libinput_event *event,
 	struct wlr_pointer_axis_event wlr_event = {
 		.pointer = pointer,
 		.time_msec = usec_to_msec(libinput_event_pointer_get_time_usec(pevent)),
+		.time_usec = libinput_event_pointer_get_time_usec(pevent),
 		.source = source,
 	};
 
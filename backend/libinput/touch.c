@@ -31,8 +31,8 @@ void handle_touch_down(struct libinput_event *event,
 		libinput_event_get_touch_event(event);
 	struct wlr_touch_down_event wlr_event = { 0 };
 	wlr_event.touch = touch;
-	wlr_event.time_msec =
-		usec_to_msec(libinput_event_touch_get_time_usec(tevent));
+	wlr_event.time_usec = libinput_event_touch_get_time_usec(tevent);
+	wlr_event.time_msec = usec_to_msec(wlr_event.time_usec);
 	wlr_event.touch_id = libinput_event_touch_get_seat_slot(tevent);
 	wlr_event.x = libinput_event_touch_get_x_transformed(tevent, 1);
 	wlr_event.y = libinput_event_touch_get_y_transformed(tevent, 1);
@@ -46,6 +46,7 @@ void handle_touch_up(struct libinput_event *event,
 	struct wlr_touch_up_event wlr_event = {
 		.touch = touch,
 		.time_msec = usec_to_msec(libinput_event_touch_get_time_usec(tevent)),
+		.time_usec = libinput_event_touch_get_time_usec(tevent),
 		.touch_id = libinput_event_touch_get_seat_slot(tevent),
 	};
 	wl_signal_emit_mutable(&touch->events.up, &wlr_event);
@@ -58,6 +59,7 @@ void handle_touch_motion(struct libinput_event *event,
 	struct wlr_touch_motion_event wlr_event = {
 		.touch = touch,
 		.time_msec = usec_to_msec(libinput_event_touch_get_time_usec(tevent)),
+		.time_usec = libinput_event_touch_get_time_usec(tevent),
 		.touch_id = libinput_event_touch_get_seat_slot(tevent),
 		.x = libinput_event_touch_get_x_transformed(tevent, 1),
 		.y = libinput_event_touch_get_y_transformed(tevent, 1),
@@ -72,6 +74,7 @@ void handle_touch_cancel(struct libinput_event *event,
 	struct wlr_touch_cancel_event wlr_event = {
 		.touch = touch,
 		.time_msec = usec_to_msec(libinput_event_touch_get_time_usec(tevent)),
+		.time_usec = libinput_event_touch_get_time_usec(tevent),
 		.touch_id = libinput_event_touch_get_seat_slot(tevent),
 	};
 	wl_signal_emit_mutable(&touch->events.cancel, &wlr_event);
@@ -117,6 +117,28 @@ static int compare_output_state_backend(const void *data_a, const void *data_b)
 static bool commit(struct wlr_backend *backend,
 		const struct wlr_backend_output_state *states, size_t states_len,
 		bool test_only) {
+	if (states_len == 0) {
+		return true;
+	}
+
+	// Most of the time, all outputs belong to the same backend: skip the
+	// copy and sort
+	struct wlr_backend *first = states[0].output->backend;
+	bool single_backend = true;
+	for (size_t i = 1; i < states_len; i++) {
+		if (states[i].output->backend != first) {
+			single_backend = false;
+			break;
+		}
+	}
+	if (single_backend) {
+		if (test_only) {
+			return wlr_backend_test(first, states, states_len);
+		} else {
+			return wlr_backend_commit(first, states, states_len);
+		}
+	}
+
 	// Group states by backend, then perform one commit per backend
 	struct wlr_backend_output_state *by_backend = malloc(states_len * sizeof(by_backend[0]));
 	if (by_backend == NULL) {
@@ -126,7 +148,8 @@ static bool commit(struct wlr_backend *backend,
 	qsort(by_backend, states_len, sizeof(by_backend[0]), compare_output_state_backend);
 
 	bool ok = true;
-	for (size_t i = 0; i < states_len; i++) {
+	size_t i = 0;
+	while (i < states_len) {
 		struct wlr_backend *sub = by_backend[i].output->backend;
 
 		size_t j = i;
@@ -142,6 +165,8 @@ static bool commit(struct wlr_backend *backend,
 		if (!ok) {
 			break;
 		}
+
+		i = j;
 	}
 
 	free(by_backend);
@@ -581,6 +581,7 @@ struct wlr_backend *wlr_wl_backend_create(struct wl_event_loop *loop,
 	wl_list_init(&wl->outputs);
 	wl_list_init(&wl->seats);
 	wl_list_init(&wl->buffers);
+	wl->buffer_cache.max_idle = WL_BUFFER_CACHE_DEFAULT_MAX_IDLE;
 
 	if (remote_display != NULL) {
 		wl->remote_display = remote_display;
@@ -699,3 +700,22 @@ struct wl_display *wlr_wl_backend_get_remote_display(struct wlr_backend *backend
 	struct wlr_wl_backend *wl = get_wl_backend_from_backend(backend);
 	return wl->remote_display;
 }
+
+void wlr_wl_backend_set_buffer_cache_size(struct wlr_backend *backend,
+		size_t max_idle) {
+	struct wlr_wl_backend *wl = get_wl_backend_from_backend(backend);
+	wl->buffer_cache.max_idle = max_idle;
+	evict_idle_wl_buffers(wl);
+}
+
+void wlr_wl_backend_get_buffer_cache_stats(struct wlr_backend *backend,
+		struct wlr_wl_buffer_cache_stats *stats) {
+	struct wlr_wl_backend *wl = get_wl_backend_from_backend(backend);
+	*stats = (struct wlr_wl_buffer_cache_stats){
+		.hits = wl->buffer_cache.hits,
+		.misses = wl->buffer_cache.misses,
+		.evictions = wl->buffer_cache.evictions,
+		.live = wl->buffer_cache.n_live,
+		.idle = wl->buffer_cache.n_idle,
+	};
+}
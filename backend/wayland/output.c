@@ -19,6 +19,7 @@
 #include "render/pixel_format.h"
 #include "render/wlr_renderer.h"
 #include "types/wlr_output.h"
+#include "util/time.h"
 
 #include "linux-dmabuf-v1-client-protocol.h"
 #include "presentation-time-client-protocol.h"
@@ -58,6 +59,50 @@ struct wlr_wl_output *get_wl_output_from_surface(struct wlr_wl_backend *wl,
 	return output;
 }
 
+/**
+ * Send a frame event, unless one has already been sent for the parent
+ * compositor's next vblank. In that case, the frame event is delayed until
+ * that vblank. This avoids bursts of frames when frame callbacks are delayed
+ * by a busy parent compositor.
+ */
+static void send_paced_frame(struct wlr_wl_output *output) {
+	int64_t refresh_nsec = output->pacing.refresh_nsec;
+	int64_t last_present_nsec = output->pacing.last_present_nsec;
+	if (output->pacing.timer == NULL || refresh_nsec <= 0 ||
+			last_present_nsec == 0) {
+		wlr_output_send_frame(&output->wlr_output);
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t now_nsec = timespec_to_nsec(&now);
+
+	int64_t next_vblank_nsec = last_present_nsec;
+	if (now_nsec >= last_present_nsec) {
+		next_vblank_nsec += refresh_nsec *
+			((now_nsec - last_present_nsec) / refresh_nsec + 1);
+	}
+
+	if (next_vblank_nsec > output->pacing.last_target_nsec) {
+		output->pacing.last_target_nsec = next_vblank_nsec;
+		wlr_output_send_frame(&output->wlr_output);
+		return;
+	}
+
+	int delay_ms = (next_vblank_nsec - now_nsec + 999999) / 1000000;
+	if (delay_ms < 1) {
+		delay_ms = 1;
+	}
+	wl_event_source_timer_update(output->pacing.timer, delay_ms);
+}
+
+static int handle_pacing_timer(void *data) {
+	struct wlr_wl_output *output = data;
+	send_paced_frame(output);
+	return 0;
+}
+
 static void surface_frame_callback(void *data, struct wl_callback *cb,
 		uint32_t time) {
 	struct wlr_wl_output *output = data;
@@ -70,7 +115,24 @@ static void surface_frame_callback(void *data, struct wl_callback *cb,
 	wl_callback_destroy(cb);
 	output->frame_callback = NULL;
 
-	wlr_output_send_frame(&output->wlr_output);
+	send_paced_frame(output);
+}
+
+static void update_pacing(struct wlr_wl_output *output,
+		const struct timespec *when, uint64_t seq, int64_t refresh_nsec) {
+	int64_t present_nsec = timespec_to_nsec(when);
+
+	if (refresh_nsec == 0 && output->pacing.last_present_nsec != 0 &&
+			seq > output->pacing.last_present_seq &&
+			present_nsec > output->pacing.last_present_nsec) {
+		// The parent compositor doesn't know its refresh rate, estimate it
+		refresh_nsec = (present_nsec - output->pacing.last_present_nsec) /
+			(int64_t)(seq - output->pacing.last_present_seq);
+	}
+
+	output->pacing.last_present_nsec = present_nsec;
+	output->pacing.last_present_seq = seq;
+	output->pacing.refresh_nsec = refresh_nsec;
 }
 
 static const struct wl_callback_listener frame_listener = {
@@ -99,12 +161,16 @@ static void presentation_feedback_handle_presented(void *data,
 		.tv_sec = ((uint64_t)tv_sec_hi << 32) | tv_sec_lo,
 		.tv_nsec = tv_nsec,
 	};
+	uint64_t seq = ((uint64_t)seq_hi << 32) | seq_lo;
+	struct wlr_wl_output *output = feedback->output;
+	update_pacing(output, &t, seq, refresh_ns);
+
 	struct wlr_output_event_present event = {
 		.commit_seq = feedback->commit_seq,
 		.presented = true,
 		.when = &t,
-		.seq = ((uint64_t)seq_hi << 32) | seq_lo,
-		.refresh = refresh_ns,
+		.seq = seq,
+		.refresh = output->pacing.refresh_nsec,
 		.flags = flags,
 	};
 	wlr_output_send_present(&feedback->output->wlr_output, &event);
@@ -139,16 +205,36 @@ void destroy_wl_buffer(struct wlr_wl_buffer *buffer) {
 	wl_list_remove(&buffer->buffer_destroy.link);
 	wl_list_remove(&buffer->link);
 	wl_buffer_destroy(buffer->wl_buffer);
-	if (!buffer->released) {
+	buffer->backend->buffer_cache.n_live--;
+	if (buffer->released) {
+		buffer->backend->buffer_cache.n_idle--;
+	} else {
 		wlr_buffer_unlock(buffer->buffer);
 	}
 	free(buffer);
 }
 
+void evict_idle_wl_buffers(struct wlr_wl_backend *wl) {
+	struct wlr_wl_buffer *buffer, *tmp;
+	wl_list_for_each_reverse_safe(buffer, tmp, &wl->buffers, link) {
+		if (wl->buffer_cache.n_idle <= wl->buffer_cache.max_idle) {
+			break;
+		}
+		if (buffer->released) {
+			// Released buffers aren't locked, this can't destroy other buffers
+			destroy_wl_buffer(buffer);
+			wl->buffer_cache.evictions++;
+		}
+	}
+}
+
 static void buffer_handle_release(void *data, struct wl_buffer *wl_buffer) {
 	struct wlr_wl_buffer *buffer = data;
+	struct wlr_wl_backend *wl = buffer->backend;
 	buffer->released = true;
+	wl->buffer_cache.n_idle++;
 	wlr_buffer_unlock(buffer->buffer); // might free buffer
+	evict_idle_wl_buffers(wl);
 }
 
 static const struct wl_buffer_listener buffer_listener = {
@@ -234,9 +320,11 @@ static struct wlr_wl_buffer *create_wl_buffer(struct wlr_wl_backend *wl,
 		wl_buffer_destroy(wl_buffer);
 		return NULL;
 	}
+	buffer->backend = wl;
 	buffer->wl_buffer = wl_buffer;
 	buffer->buffer = wlr_buffer_lock(wlr_buffer);
 	wl_list_insert(&wl->buffers, &buffer->link);
+	wl->buffer_cache.n_live++;
 
 	wl_buffer_add_listener(wl_buffer, &buffer_listener, buffer);
 
@@ -255,11 +343,16 @@ static struct wlr_wl_buffer *get_or_create_wl_buffer(struct wlr_wl_backend *wl,
 		// wl_surface.commit.
 		if (buffer->buffer == wlr_buffer && buffer->released) {
 			buffer->released = false;
+			wl->buffer_cache.n_idle--;
+			wl->buffer_cache.hits++;
 			wlr_buffer_lock(buffer->buffer);
+			wl_list_remove(&buffer->link);
+			wl_list_insert(&wl->buffers, &buffer->link);
 			return buffer;
 		}
 	}
 
+	wl->buffer_cache.misses++;
 	return create_wl_buffer(wl, wlr_buffer);
 }
 
@@ -661,6 +754,10 @@ static void output_destroy(struct wlr_output *wlr_output) {
 		wl_callback_destroy(output->frame_callback);
 	}
 
+	if (output->pacing.timer != NULL) {
+		wl_event_source_remove(output->pacing.timer);
+	}
+
 	struct wlr_wl_presentation_feedback *feedback, *feedback_tmp;
 	wl_list_for_each_safe(feedback, feedback_tmp,
 			&output->presentation_feedbacks, link) {
@@ -793,6 +890,12 @@ static struct wlr_wl_output *output_create(struct wlr_wl_backend *backend,
 	output->backend = backend;
 	wl_list_init(&output->presentation_feedbacks);
 
+	output->pacing.timer = wl_event_loop_add_timer(backend->event_loop,
+		handle_pacing_timer, output);
+	if (output->pacing.timer == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create frame pacing timer");
+	}
+
 	wl_proxy_set_tag((struct wl_proxy *)output->surface, &surface_tag);
 	wl_surface_set_user_data(output->surface, output);
 
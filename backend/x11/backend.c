@@ -481,10 +481,11 @@ struct wlr_backend *wlr_x11_backend_create(struct wl_event_loop *loop,
 			xcb_shm_query_version_reply(x11->xcb, shm_cookie, NULL);
 		if (shm_reply) {
 			if (shm_reply->major_version >= 1 || shm_reply->minor_version >= 2) {
-				if (shm_reply->shared_pixmaps) {
-					x11->have_shm = true;
-				} else {
-					wlr_log(WLR_INFO, "X11 does not support shared pixmaps");
+				x11->have_shm = true;
+				x11->have_shm_shared_pixmaps = shm_reply->shared_pixmaps;
+				if (!shm_reply->shared_pixmaps) {
+					wlr_log(WLR_INFO, "X11 does not support shared pixmaps, "
+						"falling back to copies");
 				}
 			} else {
 				wlr_log(WLR_INFO, "X11 does not support required SHM version "
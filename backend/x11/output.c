@@ -104,6 +104,10 @@ static void output_destroy(struct wlr_output *wlr_output) {
 		destroy_x11_buffer(buffer);
 	}
 
+	if (output->shm_gc != XCB_NONE) {
+		xcb_free_gc(x11->xcb, output->shm_gc);
+	}
+
 	wl_list_remove(&output->link);
 
 	if (output->cursor.pic != XCB_NONE) {
@@ -176,6 +180,10 @@ static void destroy_x11_buffer(struct wlr_x11_buffer *buffer) {
 	wl_list_remove(&buffer->buffer_destroy.link);
 	wl_list_remove(&buffer->link);
 	xcb_free_pixmap(buffer->x11->xcb, buffer->pixmap);
+	if (buffer->shm_seg != XCB_NONE) {
+		xcb_shm_detach(buffer->x11->xcb, buffer->shm_seg);
+		pixman_region32_fini(&buffer->shm_damage);
+	}
 	for (size_t i = 0; i < buffer->n_busy; i++) {
 		wlr_buffer_unlock(buffer->buffer);
 	}
@@ -235,7 +243,7 @@ static xcb_pixmap_t import_dmabuf(struct wlr_x11_output *output,
 }
 
 static xcb_pixmap_t import_shm(struct wlr_x11_output *output,
-		struct wlr_shm_attributes *shm) {
+		struct wlr_shm_attributes *shm, xcb_shm_seg_t *seg_ptr) {
 	struct wlr_x11_backend *x11 = output->x11;
 
 	if (shm->format != x11->x11_format->drm) {
@@ -255,6 +263,15 @@ static xcb_pixmap_t import_shm(struct wlr_x11_output *output,
 	xcb_shm_attach_fd(x11->xcb, seg, fd, false);
 
 	xcb_pixmap_t pixmap = xcb_generate_id(x11->xcb);
+	if (!x11->have_shm_shared_pixmaps) {
+		// Keep the segment attached: damaged regions are copied from it on
+		// each commit
+		xcb_create_pixmap(x11->xcb, x11->x11_format->depth, pixmap,
+			output->win, shm->width, shm->height);
+		*seg_ptr = seg;
+		return pixmap;
+	}
+
 	xcb_shm_create_pixmap(x11->xcb, pixmap, output->win, shm->width,
 		shm->height, x11->x11_format->depth, seg, shm->offset);
 
@@ -267,13 +284,14 @@ static struct wlr_x11_buffer *create_x11_buffer(struct wlr_x11_output *output,
 		struct wlr_buffer *wlr_buffer) {
 	struct wlr_x11_backend *x11 = output->x11;
 	xcb_pixmap_t pixmap = XCB_PIXMAP_NONE;
+	xcb_shm_seg_t shm_seg = XCB_NONE;
 
 	struct wlr_dmabuf_attributes dmabuf_attrs;
 	struct wlr_shm_attributes shm_attrs;
 	if (wlr_buffer_get_dmabuf(wlr_buffer, &dmabuf_attrs)) {
 		pixmap = import_dmabuf(output, &dmabuf_attrs);
 	} else if (wlr_buffer_get_shm(wlr_buffer, &shm_attrs)) {
-		pixmap = import_shm(output, &shm_attrs);
+		pixmap = import_shm(output, &shm_attrs, &shm_seg);
 	}
 
 	if (pixmap == XCB_PIXMAP_NONE) {
@@ -283,12 +301,21 @@ static struct wlr_x11_buffer *create_x11_buffer(struct wlr_x11_output *output,
 	struct wlr_x11_buffer *buffer = calloc(1, sizeof(*buffer));
 	if (!buffer) {
 		xcb_free_pixmap(x11->xcb, pixmap);
+		if (shm_seg != XCB_NONE) {
+			xcb_shm_detach(x11->xcb, shm_seg);
+		}
 		return NULL;
 	}
 	buffer->buffer = wlr_buffer_lock(wlr_buffer);
 	buffer->n_busy = 1;
 	buffer->pixmap = pixmap;
 	buffer->x11 = x11;
+	buffer->shm_seg = shm_seg;
+	if (shm_seg != XCB_NONE) {
+		// The whole pixmap needs to be copied on first use
+		pixman_region32_init_rect(&buffer->shm_damage, 0, 0,
+			wlr_buffer->width, wlr_buffer->height);
+	}
 	wl_list_insert(&output->buffers, &buffer->link);
 
 	buffer->buffer_destroy.notify = buffer_handle_buffer_destroy;
@@ -311,6 +338,61 @@ static struct wlr_x11_buffer *get_or_create_x11_buffer(
 	return create_x11_buffer(output, wlr_buffer);
 }
 
+static void copy_shm_damage(struct wlr_x11_output *output,
+		struct wlr_x11_buffer *buffer) {
+	struct wlr_x11_backend *x11 = output->x11;
+
+	struct wlr_shm_attributes shm;
+	if (!wlr_buffer_get_shm(buffer->buffer, &shm)) {
+		return;
+	}
+
+	if (output->shm_gc == XCB_NONE) {
+		output->shm_gc = xcb_generate_id(x11->xcb);
+		xcb_create_gc(x11->xcb, output->shm_gc, buffer->pixmap, 0, NULL);
+	}
+
+	pixman_region32_intersect_rect(&buffer->shm_damage, &buffer->shm_damage,
+		0, 0, shm.width, shm.height);
+
+	uint16_t total_width = shm.stride / (x11->x11_format->bpp / 8);
+	int rects_len = 0;
+	const pixman_box32_t *rects =
+		pixman_region32_rectangles(&buffer->shm_damage, &rects_len);
+	for (int i = 0; i < rects_len; i++) {
+		const pixman_box32_t *box = &rects[i];
+		xcb_shm_put_image(x11->xcb, buffer->pixmap, output->shm_gc,
+			total_width, shm.height, box->x1, box->y1,
+			box->x2 - box->x1, box->y2 - box->y1, box->x1, box->y1,
+			x11->x11_format->depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0,
+			buffer->shm_seg, shm.offset);
+	}
+
+	pixman_region32_clear(&buffer->shm_damage);
+}
+
+/**
+ * Record the damage of a commit for all copied SHM buffers, including the one
+ * being committed, so that each copy covers what changed since the buffer was
+ * last copied.
+ */
+static void accumulate_shm_damage(struct wlr_x11_output *output,
+		const struct wlr_output_state *state) {
+	struct wlr_x11_buffer *buffer;
+	wl_list_for_each(buffer, &output->buffers, link) {
+		if (buffer->shm_seg == XCB_NONE) {
+			continue;
+		}
+		if (state->committed & WLR_OUTPUT_STATE_DAMAGE) {
+			pixman_region32_union(&buffer->shm_damage, &buffer->shm_damage,
+				&state->damage);
+		} else {
+			pixman_region32_union_rect(&buffer->shm_damage, &buffer->shm_damage,
+				0, 0, buffer->buffer->width, buffer->buffer->height);
+		}
+	}
+}
+
 static bool output_commit_buffer(struct wlr_x11_output *output,
 		const struct wlr_output_state *state) {
 	struct wlr_x11_backend *x11 = output->x11;
@@ -322,6 +404,11 @@ static bool output_commit_buffer(struct wlr_x11_output *output,
 		goto error;
 	}
 
+	accumulate_shm_damage(output, state);
+	if (x11_buffer->shm_seg != XCB_NONE) {
+		copy_shm_damage(output, x11_buffer);
+	}
+
 	xcb_xfixes_region_t region = XCB_NONE;
 	if (state->committed & WLR_OUTPUT_STATE_DAMAGE) {
 		pixman_region32_union(&output->exposed, &output->exposed, &state->damage);
@@ -745,7 +832,22 @@ void handle_x11_present_event(struct wlr_x11_backend *x11,
 			return;
 		}
 
+		if (output->last_msc != 0 && complete_notify->msc > output->last_msc &&
+				complete_notify->ust > output->last_ust) {
+			// The X server doesn't report the refresh rate, estimate it from
+			// the UST/MSC pairs
+			int64_t refresh_nsec =
+				(int64_t)(complete_notify->ust - output->last_ust) * 1000 /
+				(int64_t)(complete_notify->msc - output->last_msc);
+			if (output->refresh_nsec == 0) {
+				output->refresh_nsec = refresh_nsec;
+			} else {
+				output->refresh_nsec =
+					(output->refresh_nsec * 7 + refresh_nsec) / 8;
+			}
+		}
 		output->last_msc = complete_notify->msc;
+		output->last_ust = complete_notify->ust;
 
 		struct timespec t;
 		timespec_from_nsec(&t, complete_notify->ust * 1000);
@@ -762,6 +864,7 @@ void handle_x11_present_event(struct wlr_x11_backend *x11,
 			.presented = presented,
 			.when = &t,
 			.seq = complete_notify->msc,
+			.refresh = output->refresh_nsec,
 			.flags = flags,
 		};
 		wlr_output_send_present(&output->wlr_output, &present_event);
@@ -3,6 +3,9 @@
 
 #include <wlr/backend/headless.h>
 #include <wlr/backend/interface.h>
+#include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_pointer.h>
+#include <wlr/types/wlr_touch.h>
 
 #define HEADLESS_DEFAULT_REFRESH (60 * 1000) // 60 Hz
 
@@ -10,6 +13,7 @@ struct wlr_headless_backend {
 	struct wlr_backend backend;
 	struct wl_event_loop *event_loop;
 	struct wl_list outputs;
+	struct wl_list input_devices; // wlr_headless_input_device.link
 	struct wl_listener event_loop_destroy;
 	bool started;
 };
@@ -24,7 +28,46 @@ struct wlr_headless_output {
 	int frame_delay; // ms
 };
 
+struct wlr_headless_input_device {
+	union {
+		struct wlr_keyboard keyboard;
+		struct wlr_pointer pointer;
+		struct wlr_touch touch;
+	};
+	enum wlr_input_device_type type;
+
+	struct wlr_headless_backend *backend;
+	struct wl_list link;
+};
+
+enum wlr_headless_trace_event_type {
+	HEADLESS_TRACE_KEY,
+	HEADLESS_TRACE_POINTER_MOTION,
+	HEADLESS_TRACE_POINTER_MOTION_ABSOLUTE,
+	HEADLESS_TRACE_POINTER_BUTTON,
+	HEADLESS_TRACE_POINTER_AXIS,
+	HEADLESS_TRACE_POINTER_FRAME,
+	HEADLESS_TRACE_TOUCH_DOWN,
+	HEADLESS_TRACE_TOUCH_UP,
+	HEADLESS_TRACE_TOUCH_MOTION,
+	HEADLESS_TRACE_TOUCH_CANCEL,
+	HEADLESS_TRACE_TOUCH_FRAME,
+};
+
+struct wlr_headless_trace_event {
+	enum wlr_headless_trace_event_type type;
+	uint64_t time_usec;
+	uint32_t code; // keycode, button or axis source
+	uint32_t state; // key or button state, axis orientation
+	int32_t value; // touch ID or discrete axis delta
+	double x, y; // position, motion or axis delta
+	double unaccel_x, unaccel_y;
+};
+
 struct wlr_headless_backend *headless_backend_from_backend(
 	struct wlr_backend *wlr_backend);
+void destroy_headless_input_device(struct wlr_headless_input_device *device);
+struct wlr_input_device *headless_input_device_base(
+	struct wlr_headless_input_device *device);
 
 #endif
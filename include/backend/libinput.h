@@ -21,11 +21,21 @@ struct wlr_libinput_backend {
 
 	struct libinput *libinput_context;
 	struct wl_event_source *input_event;
+	struct wl_event_source *queued_events_idle; // may be NULL
 
 	struct wl_listener session_destroy;
 	struct wl_listener session_signal;
 
 	struct wl_list devices; // wlr_libinput_device.link
+
+	struct {
+		bool enabled;
+		uint32_t max_delay_usec;
+		bool pending;
+		struct wlr_libinput_input_device *device; // with pending motion
+		uint64_t first_time_usec; // time of the oldest pending event
+		struct wl_event_source *timer; // may be NULL
+	} motion_coalescing;
 };
 
 struct wlr_libinput_input_device {
@@ -39,6 +49,12 @@ struct wlr_libinput_input_device {
 	struct wl_list tablet_tools; // see backend/libinput/tablet_tool.c
 	struct wlr_tablet_pad tablet_pad;
 
+	struct {
+		bool has_motion, has_motion_absolute;
+		struct wlr_pointer_motion_event motion;
+		struct wlr_pointer_motion_absolute_event motion_absolute;
+	} pending_motion;
+
 	struct wl_list link;
 };
 
@@ -64,9 +80,14 @@ void handle_keyboard_key(struct libinput_event *event, struct wlr_keyboard *kb);
 void init_device_pointer(struct wlr_libinput_input_device *dev);
 struct wlr_libinput_input_device *device_from_pointer(struct wlr_pointer *kb);
 void handle_pointer_motion(struct libinput_event *event,
-	struct wlr_pointer *pointer);
+	struct wlr_pointer *pointer, bool coalesce);
 void handle_pointer_motion_abs(struct libinput_event *event,
-	struct wlr_pointer *pointer);
+	struct wlr_pointer *pointer, bool coalesce);
+void flush_pointer_motion(struct wlr_pointer *pointer);
+
+bool coalesce_pointer_motion(struct wlr_libinput_backend *backend,
+	struct libinput_event *event);
+void flush_coalesced_motion(struct wlr_libinput_backend *backend);
 void handle_pointer_button(struct libinput_event *event,
 	struct wlr_pointer *pointer);
 void handle_pointer_axis(struct libinput_event *event,
@@ -15,6 +15,9 @@
 #include <wlr/types/wlr_touch.h>
 #include <wlr/render/drm_format_set.h>
 
+// Number of imported buffers released by the parent compositor kept around
+#define WL_BUFFER_CACHE_DEFAULT_MAX_IDLE 32
+
 struct wlr_wl_backend {
 	struct wlr_backend backend;
 
@@ -23,7 +26,12 @@ struct wlr_wl_backend {
 	struct wl_event_loop *event_loop;
 	struct wl_list outputs;
 	int drm_fd;
-	struct wl_list buffers; // wlr_wl_buffer.link
+	struct wl_list buffers; // wlr_wl_buffer.link, most recently used first
+	struct {
+		size_t max_idle; // released imports kept for re-use
+		size_t n_idle, n_live;
+		uint64_t hits, misses, evictions;
+	} buffer_cache;
 	size_t requested_outputs;
 	struct wl_listener event_loop_destroy;
 	char *activation_token;
@@ -53,6 +61,7 @@ struct wlr_wl_backend {
 };
 
 struct wlr_wl_buffer {
+	struct wlr_wl_backend *backend;
 	struct wlr_buffer *buffer;
 	struct wl_buffer *wl_buffer;
 	bool released;
@@ -90,6 +99,15 @@ struct wlr_wl_output {
 	struct zxdg_toplevel_decoration_v1 *zxdg_toplevel_decoration_v1;
 	struct wl_list presentation_feedbacks;
 
+	// Prediction of the parent compositor's vblanks from presentation feedback
+	struct {
+		int64_t last_present_nsec; // 0 if unknown
+		uint64_t last_present_seq;
+		int64_t refresh_nsec; // 0 if unknown
+		int64_t last_target_nsec; // vblank targeted by the last frame event
+		struct wl_event_source *timer; // may be NULL
+	} pacing;
+
 	bool configured;
 	uint32_t enter_serial;
 
@@ -175,6 +193,7 @@ bool create_wl_seat(struct wl_seat *wl_seat, struct wlr_wl_backend *wl,
 	uint32_t global_name);
 void destroy_wl_seat(struct wlr_wl_seat *seat);
 void destroy_wl_buffer(struct wlr_wl_buffer *buffer);
+void evict_idle_wl_buffers(struct wlr_wl_backend *wl);
 
 extern const struct wlr_pointer_impl wl_pointer_impl;
 extern const struct wlr_tablet_pad_impl wl_tablet_pad_impl;
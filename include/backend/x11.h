@@ -8,6 +8,7 @@
 #include <wayland-server-core.h>
 #include <xcb/xcb.h>
 #include <xcb/present.h>
+#include <xcb/shm.h>
 
 #include <pixman.h>
 #include <wlr/backend/x11.h>
@@ -46,7 +47,11 @@ struct wlr_x11_output {
 
 	pixman_region32_t exposed;
 
+	xcb_gcontext_t shm_gc; // XCB_NONE until needed
+
 	uint64_t last_msc;
+	uint64_t last_ust; // usec
+	int64_t refresh_nsec; // estimated from Present events, 0 if unknown
 
 	struct {
 		struct wlr_swapchain *swapchain;
@@ -74,6 +79,7 @@ struct wlr_x11_backend {
 	xcb_render_pictformat_t argb32;
 
 	bool have_shm;
+	bool have_shm_shared_pixmaps;
 	bool have_dri3;
 	uint32_t dri3_major_version, dri3_minor_version;
 
@@ -118,6 +124,11 @@ struct wlr_x11_buffer {
 	struct wl_list link; // wlr_x11_output.buffers
 	struct wl_listener buffer_destroy;
 	size_t n_busy;
+
+	// Without shared pixmap support, SHM buffers are copied into a
+	// server-side pixmap with ShmPutImage
+	xcb_shm_seg_t shm_seg; // XCB_NONE if the pixmap is shared or a DMA-BUF
+	pixman_region32_t shm_damage; // not yet copied to the pixmap
 };
 
 struct wlr_x11_format {
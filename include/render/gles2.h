@@ -32,10 +32,10 @@ struct wlr_gles2_pixel_format {
 struct wlr_gles2_tex_shader {
 	GLuint program;
 	GLint proj;
-	GLint tex_proj;
 	GLint tex;
 	GLint alpha;
 	GLint pos_attrib;
+	GLint texcoord_attrib;
 };
 
 struct wlr_gles2_renderer {
@@ -130,12 +130,30 @@ struct wlr_gles2_texture {
 	struct wlr_gles2_buffer *buffer; // for DMA-BUF imports only
 };
 
+/**
+ * GL state shared by all quads of a draw batch.
+ */
+struct wlr_gles2_batch_state {
+	const struct wlr_gles2_tex_shader *tex_shader; // NULL for solid rects
+	GLenum target;
+	GLuint tex;
+	enum wlr_scale_filter_mode filter_mode;
+	enum wlr_render_blend_mode blend_mode;
+	float alpha;
+	struct wlr_render_color color;
+};
+
 struct wlr_gles2_render_pass {
 	struct wlr_render_pass base;
 	struct wlr_gles2_buffer *buffer;
 	float projection_matrix[9];
 	struct wlr_egl_context prev_ctx;
 	struct wlr_gles2_render_timer *timer;
+
+	// Consecutive operations sharing the same state are accumulated and
+	// drawn with a single call
+	struct wlr_gles2_batch_state batch_state;
+	struct wl_array batch_verts; // GLfloat: x, y, u, v
 };
 
 bool is_gles2_pixel_format_supported(const struct wlr_gles2_renderer *renderer,
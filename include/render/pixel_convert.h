@@ -0,0 +1,24 @@
+#ifndef RENDER_PIXEL_CONVERT_H
+#define RENDER_PIXEL_CONVERT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Check whether pixels can be converted from src_format to dst_format with
+ * pixel_convert().
+ */
+bool pixel_convert_supported(uint32_t dst_format, uint32_t src_format);
+
+/**
+ * Convert a rectangle of width×height pixels between two DRM formats on the
+ * CPU.
+ *
+ * Returns false if the conversion isn't supported.
+ */
+bool pixel_convert(void *dst, uint32_t dst_format, size_t dst_stride,
+	const void *src, uint32_t src_format, size_t src_stride,
+	uint32_t width, uint32_t height);
+
+#endif
@@ -9,6 +9,7 @@
 #include <wlr/render/wlr_texture.h>
 #include <wlr/render/drm_format_set.h>
 #include <wlr/render/interface.h>
+#include <wlr/render/vulkan.h>
 #include <wlr/util/addon.h>
 #include "util/rect_union.h"
 
@@ -281,6 +282,8 @@ struct wlr_vk_renderer {
 		VkImage dst_image;
 		VkDeviceMemory dst_img_memory;
 	} read_pixels_cache;
+
+	struct wlr_vk_render_stats stats;
 };
 
 // vertex shader push constant range data
@@ -321,6 +324,33 @@ VkCommandBuffer vulkan_record_stage_cb(struct wlr_vk_renderer *renderer);
 // finished execution.
 bool vulkan_submit_stage_wait(struct wlr_vk_renderer *renderer);
 
+enum wlr_vk_render_op_type {
+	WLR_VK_RENDER_OP_DRAW,
+	WLR_VK_RENDER_OP_CLEAR,
+};
+
+// A render pass operation, recorded when added to the pass and emitted into
+// the command buffer on submit
+struct wlr_vk_render_op {
+	enum wlr_vk_render_op_type type;
+
+	// WLR_VK_RENDER_OP_DRAW only
+	const struct wlr_vk_pipeline *pipe;
+	VkDescriptorSet ds; // VK_NULL_HANDLE for single color draws
+	struct wlr_vk_vert_pcr_data vert_pcr_data;
+	float frag_pcr_data[4]; // color or alpha
+	uint32_t frag_pcr_size;
+
+	// WLR_VK_RENDER_OP_CLEAR only
+	VkClearAttachment clear_att;
+	VkClearRect clear_rect;
+
+	// Scissor rects, in wlr_vk_render_pass.rects
+	size_t rects_offset, rects_len;
+	// Extents of the area the operation may touch
+	pixman_box32_t bounds;
+};
+
 struct wlr_vk_render_pass {
 	struct wlr_render_pass base;
 	struct wlr_vk_renderer *renderer;
@@ -328,17 +358,22 @@ struct wlr_vk_render_pass {
 	struct wlr_vk_command_buffer *command_buffer;
 	struct rect_union updated_region;
 	VkPipeline bound_pipeline;
+	VkPipelineLayout bound_layout;
+	VkDescriptorSet bound_ds;
 	float projection[9];
 	bool failed;
+
+	struct wl_array ops; // struct wlr_vk_render_op
+	struct wl_array rects; // VkRect2D
 };
 
 struct wlr_vk_render_pass *vulkan_begin_render_pass(struct wlr_vk_renderer *renderer,
 	struct wlr_vk_render_buffer *buffer);
 
-// Suballocates a buffer span with the given size that can be mapped
-// and used as staging buffer. The allocation is implicitly released when the
-// stage cb has finished execution. The start of the span will be a multiple
-// of the given alignment.
+// Suballocates a buffer span with the given size that can be used as staging
+// buffer. The span is accessible via the buffer's persistent CPU mapping. The
+// allocation is implicitly released when the stage cb has finished execution.
+// The start of the span will be a multiple of the given alignment.
 struct wlr_vk_buffer_span vulkan_get_stage_span(
 	struct wlr_vk_renderer *renderer, VkDeviceSize size,
 	VkDeviceSize alignment);
@@ -435,7 +470,9 @@ struct wlr_vk_shared_buffer {
 	VkBuffer buffer;
 	VkDeviceMemory memory;
 	VkDeviceSize buf_size;
+	void *cpu_mapping; // persistently mapped for the lifetime of the buffer
 	struct wl_array allocs; // struct wlr_vk_allocation
+	int64_t last_used_ms;
 };
 
 // Suballocated range on a buffer.
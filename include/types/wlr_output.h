@@ -20,6 +20,11 @@ bool output_cursor_set_texture(struct wlr_output_cursor *cursor,
 	int dst_width, int dst_height, enum wl_output_transform transform,
 	int32_t hotspot_x, int32_t hotspot_y);
 
+/**
+ * Check whether any software cursor is drawn on the output.
+ */
+bool output_has_software_cursors(struct wlr_output *output);
+
 void output_defer_present(struct wlr_output *output, struct wlr_output_event_present event);
 
 bool output_prepare_commit(struct wlr_output *output, const struct wlr_output_state *state);
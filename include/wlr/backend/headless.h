@@ -9,9 +9,15 @@
 #ifndef WLR_BACKEND_HEADLESS_H
 #define WLR_BACKEND_HEADLESS_H
 
+#include <stdio.h>
 #include <wlr/backend.h>
+#include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_output.h>
 
+struct wlr_keyboard;
+struct wlr_pointer;
+struct wlr_touch;
+
 /**
  * Creates a headless backend. A headless backend has no outputs or inputs by
  * default.
@@ -25,7 +31,106 @@ struct wlr_backend *wlr_headless_backend_create(struct wl_event_loop *loop);
 struct wlr_output *wlr_headless_add_output(struct wlr_backend *backend,
 	unsigned int width, unsigned int height);
 
+/**
+ * Create a new headless input device. Only keyboards, pointers and touch
+ * devices are supported.
+ *
+ * The device doesn't emit any event on its own: events can be sent by the
+ * compositor via the usual device functions and signals, or replayed from a
+ * trace with wlr_headless_input_replay_create().
+ */
+struct wlr_input_device *wlr_headless_add_input_device(
+	struct wlr_backend *backend, enum wlr_input_device_type type);
+
 bool wlr_backend_is_headless(struct wlr_backend *backend);
 bool wlr_output_is_headless(struct wlr_output *output);
+bool wlr_input_device_is_headless(struct wlr_input_device *device);
+
+/**
+ * Input traces are text files with one event per line:
+ *
+ *     <time_usec> keyboard key <keycode> <state>
+ *     <time_usec> pointer motion <dx> <dy> <unaccel_dx> <unaccel_dy>
+ *     <time_usec> pointer motion_absolute <x> <y>
+ *     <time_usec> pointer button <button> <state>
+ *     <time_usec> pointer axis <source> <orientation> <delta> <delta_discrete>
+ *     <time_usec> pointer frame
+ *     <time_usec> touch down <touch_id> <x> <y>
+ *     <time_usec> touch up <touch_id>
+ *     <time_usec> touch motion <touch_id> <x> <y>
+ *     <time_usec> touch cancel <touch_id>
+ *     <time_usec> touch frame
+ *
+ * Enumerations use the values of the corresponding wl_keyboard and wl_pointer
+ * protocol enums. Events are expected in chronological order. Empty lines and
+ * lines starting with '#' are ignored.
+ */
+struct wlr_headless_input_replay {
+	struct wlr_backend *backend;
+
+	struct {
+		// Emitted when all events have been replayed
+		struct wl_signal done;
+		struct wl_signal destroy;
+	} events;
+
+	void *data;
+
+	// private state
+
+	struct wl_array trace_events; // struct wlr_headless_trace_event
+	size_t next_event;
+	double speed;
+	uint64_t start_usec;
+
+	struct wlr_keyboard *keyboard;
+	struct wlr_pointer *pointer;
+	struct wlr_touch *touch;
+
+	struct wl_event_source *timer;
+	struct wl_listener backend_destroy;
+};
+
+/**
+ * Replay an input trace read from the file descriptor on headless input
+ * devices. One keyboard, pointer and touch device is created as needed. The
+ * devices are owned by the replay and destroyed along with it.
+ *
+ * Events are replayed `speed` times faster than recorded. If `speed` is zero,
+ * events are replayed as fast as possible, while still returning to the event
+ * loop regularly. Replayed events carry the current time.
+ */
+struct wlr_headless_input_replay *wlr_headless_input_replay_create(
+	struct wlr_backend *backend, int fd, double speed);
+void wlr_headless_input_replay_destroy(struct wlr_headless_input_replay *replay);
+
+/**
+ * Records events from input devices of any backend to an input trace, for
+ * later replay with wlr_headless_input_replay_create().
+ */
+struct wlr_headless_input_recorder {
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	void *data;
+
+	// private state
+
+	FILE *file;
+	uint64_t last_time_usec;
+	struct wl_list devices; // wlr_headless_recorder_device.link
+};
+
+struct wlr_headless_input_recorder *wlr_headless_input_recorder_create(int fd);
+void wlr_headless_input_recorder_destroy(
+	struct wlr_headless_input_recorder *recorder);
+/**
+ * Start recording events from a keyboard, pointer or touch device. Recording
+ * stops when the device is destroyed.
+ */
+bool wlr_headless_input_recorder_add_device(
+	struct wlr_headless_input_recorder *recorder,
+	struct wlr_input_device *device);
 
 #endif
@@ -23,6 +23,41 @@ struct wlr_backend *wlr_libinput_backend_create(struct wlr_session *session);
 struct libinput_device *wlr_libinput_get_device_handle(
 		struct wlr_input_device *dev);
 
+/**
+ * Enable or disable pointer motion coalescing.
+ *
+ * When enabled, consecutive relative motion events of a device are merged
+ * into a single event (accelerated and unaccelerated deltas are summed), and
+ * consecutive absolute motion events are replaced by the latest one.
+ *
+ * Only one device has pending motion at a time: pending motion is always
+ * emitted before any other input event, including motion of another device,
+ * so that ordering with buttons, axis and other devices is preserved. Otherwise,
+ * it is emitted once all events readable at once have been processed if
+ * max_delay_usec is zero, or at most max_delay_usec after the first coalesced
+ * event. Compositors can also flush pending motion at frame boundaries with
+ * wlr_libinput_backend_flush_motion().
+ *
+ * Disabled by default.
+ */
+void wlr_libinput_backend_set_motion_coalescing(struct wlr_backend *backend,
+	bool enabled, uint32_t max_delay_usec);
+/**
+ * Emit pending coalesced pointer motion events, if any.
+ */
+void wlr_libinput_backend_flush_motion(struct wlr_backend *backend);
+/**
+ * Read pending events from the kernel into the libinput queue, without
+ * emitting them. The queued events are emitted from the event loop as usual,
+ * with their original kernel timestamps.
+ *
+ * Kernel input buffers are small and overflow (dropping events) if they are
+ * not read for a while. Compositors can call this function during long
+ * operations which block the event loop, for instance between rendering
+ * outputs.
+ */
+void wlr_libinput_backend_read_events(struct wlr_backend *backend);
+
 bool wlr_backend_is_libinput(struct wlr_backend *backend);
 bool wlr_input_device_is_libinput(struct wlr_input_device *device);
 
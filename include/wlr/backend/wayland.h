@@ -42,6 +42,27 @@ struct wlr_output *wlr_wl_output_create(struct wlr_backend *backend);
 struct wlr_output *wlr_wl_output_create_from_surface(struct wlr_backend *backend,
 		struct wl_surface *surface);
 
+struct wlr_wl_buffer_cache_stats {
+	uint64_t hits, misses;
+	uint64_t evictions;
+	size_t live; // imports currently alive in the parent compositor
+	size_t idle; // live imports released by the parent compositor
+};
+
+/**
+ * Set the maximum number of imported buffers released by the parent compositor
+ * which are kept around for re-use. Least recently used imports are destroyed
+ * first.
+ */
+void wlr_wl_backend_set_buffer_cache_size(struct wlr_backend *backend,
+	size_t max_idle);
+
+/**
+ * Get statistics about buffers imported in the parent compositor.
+ */
+void wlr_wl_backend_get_buffer_cache_stats(struct wlr_backend *backend,
+	struct wlr_wl_buffer_cache_stats *stats);
+
 /**
  * Check whether the provided backend is a Wayland backend.
  */
@@ -18,12 +18,25 @@ struct wlr_vk_image_attribs {
 	VkFormat format;
 };
 
+/**
+ * Cumulative render pass statistics, useful to evaluate how well operations
+ * are merged.
+ */
+struct wlr_vk_render_stats {
+	uint64_t ops; // render pass operations recorded
+	uint64_t draws;
+	uint64_t pipeline_binds;
+	uint64_t descriptor_set_binds;
+};
+
 struct wlr_renderer *wlr_vk_renderer_create_with_drm_fd(int drm_fd);
 
 VkInstance wlr_vk_renderer_get_instance(struct wlr_renderer *renderer);
 VkPhysicalDevice wlr_vk_renderer_get_physical_device(struct wlr_renderer *renderer);
 VkDevice wlr_vk_renderer_get_device(struct wlr_renderer *renderer);
 uint32_t wlr_vk_renderer_get_queue_family(struct wlr_renderer *renderer);
+void wlr_vk_renderer_get_stats(struct wlr_renderer *renderer,
+	struct wlr_vk_render_stats *stats);
 
 bool wlr_renderer_is_vk(struct wlr_renderer *wlr_renderer);
 bool wlr_texture_is_vk(struct wlr_texture *texture);
@@ -39,6 +39,11 @@ struct wlr_renderer {
 	// private state
 
 	const struct wlr_renderer_impl *impl;
+
+	size_t client_buffer_budget; // 0 means unlimited
+	size_t client_buffer_usage;
+	size_t client_buffer_evicted_usage; // copies of evicted textures
+	struct wl_list client_buffers; // wlr_client_buffer.link, most recently used first
 };
 
 /**
@@ -83,6 +88,23 @@ bool wlr_renderer_init_wl_shm(struct wlr_renderer *r,
  */
 int wlr_renderer_get_drm_fd(struct wlr_renderer *r);
 
+/**
+ * Set the maximum amount of texture memory used by uploaded wl_shm client
+ * buffers, in bytes. A budget of zero disables the limit (the default).
+ *
+ * When over budget, the textures of the least recently used client buffers
+ * are copied to system memory and destroyed. They are re-uploaded from that
+ * copy the next time they are needed (see wlr_client_buffer_get_texture()).
+ * The copies are limited to the same budget: once it's exhausted, textures
+ * are no longer evicted. Copying a texture requires a synchronous readback,
+ * so the budget should be large enough for evictions to be rare.
+ *
+ * The budget is ignored by renderers whose textures already live in system
+ * memory, such as the Pixman renderer.
+ */
+void wlr_renderer_set_client_buffer_budget(struct wlr_renderer *r,
+	size_t budget);
+
 /**
  * Destroys the renderer.
  *
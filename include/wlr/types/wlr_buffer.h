@@ -140,7 +140,9 @@ struct wlr_client_buffer {
 
 	/**
 	 * The buffer's texture, if any. A buffer will not have a texture if the
-	 * client destroys the buffer before it has been released.
+	 * client destroys the buffer before it has been released, or if the
+	 * texture has been evicted because the renderer is over its client
+	 * buffer budget. Use wlr_client_buffer_get_texture() to access it.
 	 */
 	struct wlr_texture *texture;
 	/**
@@ -154,6 +156,14 @@ struct wlr_client_buffer {
 	struct wl_listener renderer_destroy;
 
 	size_t n_ignore_locks;
+
+	struct wlr_renderer *renderer; // NULL if destroyed
+	size_t texture_size; // 0 if the texture cannot be evicted
+	// Copy of the texture contents while it's evicted, NULL otherwise
+	void *evicted_data;
+	uint32_t evicted_format;
+	uint32_t evicted_stride;
+	struct wl_list link; // wlr_renderer.client_buffers
 };
 
 /**
@@ -162,4 +172,13 @@ struct wlr_client_buffer {
  */
 struct wlr_client_buffer *wlr_client_buffer_get(struct wlr_buffer *buffer);
 
+/**
+ * Get the texture of a client buffer, re-uploading it if it has been evicted.
+ *
+ * This marks the client buffer as recently used. Returns NULL if the buffer
+ * has no texture.
+ */
+struct wlr_texture *wlr_client_buffer_get_texture(
+	struct wlr_client_buffer *buffer);
+
 #endif
@@ -0,0 +1,75 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_CLIPBOARD_CACHE_H
+#define WLR_TYPES_WLR_CLIPBOARD_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <wayland-server-core.h>
+
+struct wlr_data_source;
+struct wlr_seat;
+
+/**
+ * A compositor-side store for the selection of a seat.
+ *
+ * The data offered by the selection source is copied into memory-backed
+ * files, either as soon as the selection is set or on first paste. Further
+ * pastes are served from these copies without involving the source client,
+ * and the cached data remains available after the source is destroyed.
+ *
+ * MIME types whose data exceeds max_size are not cached and are forwarded to
+ * the source client as usual.
+ */
+struct wlr_clipboard_cache {
+	struct wlr_seat *seat;
+
+	// Maximum size of the data cached for a single MIME type, in bytes
+	size_t max_size;
+	// Fetch all MIME types when the selection is set, instead of on first
+	// paste
+	bool eager;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	void *data;
+
+	// private state
+
+	struct wl_event_loop *event_loop;
+	struct wl_list transfers; // clipboard_transfer.link
+
+	struct wl_listener seat_destroy;
+};
+
+/**
+ * Create a clipboard cache for the seat. It's destroyed with the seat.
+ */
+struct wlr_clipboard_cache *wlr_clipboard_cache_create(struct wlr_seat *seat);
+void wlr_clipboard_cache_destroy(struct wlr_clipboard_cache *cache);
+
+/**
+ * Set the seat selection, caching the data offered by the source. This is a
+ * replacement for wlr_seat_set_selection(), typically called from the
+ * wlr_seat.events.request_set_selection handler.
+ */
+void wlr_clipboard_cache_set_selection(struct wlr_clipboard_cache *cache,
+	struct wlr_data_source *source, uint32_t serial);
+
+/**
+ * Get the source whose data is cached by a source created by
+ * wlr_clipboard_cache_set_selection(). Returns NULL if that source has been
+ * destroyed. Returns the source itself if it's not a cached source.
+ */
+struct wlr_data_source *wlr_clipboard_cache_source_get_origin(
+	struct wlr_data_source *source);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_COMMIT_TIMING_V1_H
+#define WLR_TYPES_WLR_COMMIT_TIMING_V1_H
+
+#include <stdbool.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/util/addon.h>
+
+struct wlr_output;
+struct wlr_surface;
+
+struct wlr_commit_timing_manager_v1 {
+	struct wl_global *global;
+
+	struct {
+		struct wl_signal new_timer; // struct wlr_commit_timer_v1
+		struct wl_signal destroy;
+	} events;
+
+	void *data;
+
+	// private state
+
+	struct wl_listener display_destroy;
+};
+
+/**
+ * A commit timer attached to a surface.
+ *
+ * Commits carrying a target presentation timestamp are held back until the
+ * first output refresh cycle whose presentation time is at or after the
+ * target, so that they are never presented early.
+ * The compositor should assign the output the surface is presented on with
+ * wlr_commit_timer_v1_set_output(), so that the prediction is based on the
+ * output's presentation feedback. Without an output, commits are held until
+ * the target time is reached.
+ */
+struct wlr_commit_timer_v1 {
+	struct wl_resource *resource;
+	struct wlr_surface *surface;
+	struct wlr_output *output; // may be NULL
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	void *data;
+
+	// private state
+
+	struct wlr_addon addon;
+
+	bool has_pending_timestamp;
+	struct timespec pending_timestamp;
+
+	struct wl_list commits; // commit_timer_commit.link
+	struct wl_event_source *timer;
+
+	// Timing of the last presentation on the output
+	int64_t last_present_nsec;
+	int refresh_nsec;
+
+	struct wl_listener surface_client_commit;
+	struct wl_listener output_present;
+	struct wl_listener output_destroy;
+};
+
+struct wlr_commit_timing_manager_v1 *wlr_commit_timing_manager_v1_create(
+	struct wl_display *display, uint32_t version);
+
+/**
+ * Set the output used to predict presentation times for the surface. output
+ * may be NULL.
+ */
+void wlr_commit_timer_v1_set_output(struct wlr_commit_timer_v1 *timer,
+	struct wlr_output *output);
+
+#endif
@@ -119,6 +119,19 @@ struct wlr_surface_output {
 	struct wl_listener destroy;
 };
 
+/**
+ * Allocation statistics for the cached states of a surface, see
+ * wlr_surface_get_cache_stats().
+ */
+struct wlr_surface_cache_stats {
+	// Number of surface states allocated to cache commits
+	size_t state_allocs;
+	// Number of synced states allocated along with them
+	size_t synced_state_allocs;
+	// Number of commits cached with a re-used state
+	size_t reused;
+};
+
 struct wlr_surface {
 	struct wl_resource *resource;
 	struct wlr_compositor *compositor;
@@ -237,6 +250,20 @@ struct wlr_surface {
 
 	struct wl_resource *pending_buffer_resource;
 	struct wl_listener pending_buffer_resource_destroy;
+
+	struct {
+		bool enabled;
+		uint64_t *tile_hashes; // NULL if unknown
+		int buffer_width, buffer_height;
+		uint32_t format;
+	} damage_refine;
+
+	// Unused cached states, ready to be re-used
+	struct wl_list cached_pool; // wlr_surface_state.cached_state_link
+	size_t cached_pool_len;
+	struct wlr_surface_cache_stats cache_stats;
+
+	struct wl_list fence_waiters; // surface_fence_waiter.link
 };
 
 struct wlr_renderer;
@@ -244,6 +271,8 @@ struct wlr_renderer;
 struct wlr_compositor {
 	struct wl_global *global;
 	struct wlr_renderer *renderer; // may be NULL
+	// Whether commits are held until the DMA-BUF fences have signaled
+	bool wait_dmabuf_fences;
 
 	struct wl_listener display_destroy;
 	struct wl_listener renderer_destroy;
@@ -404,6 +433,24 @@ void wlr_surface_for_each_surface(struct wlr_surface *surface,
 void wlr_surface_get_effective_damage(struct wlr_surface *surface,
 	pixman_region32_t *damage);
 
+/**
+ * Enable or disable damage refinement for the surface.
+ *
+ * When enabled, the damage of each committed shm buffer is reduced to the
+ * tiles whose contents actually changed since the previous buffer. This helps
+ * with clients which always submit full damage, at the cost of hashing the
+ * damaged parts of each buffer on the CPU. Disabled by default.
+ */
+void wlr_surface_set_damage_refinement(struct wlr_surface *surface,
+	bool enabled);
+
+/**
+ * Get allocation statistics for the states cached by the surface, e.g. for
+ * synchronized subsurfaces or locked commits.
+ */
+void wlr_surface_get_cache_stats(struct wlr_surface *surface,
+	struct wlr_surface_cache_stats *stats);
+
 /**
  * Get the source rectangle describing the region of the buffer that needs to
  * be sampled to render this surface's current state. The box is in
@@ -536,4 +583,15 @@ struct wlr_compositor *wlr_compositor_create(struct wl_display *display,
 void wlr_compositor_set_renderer(struct wlr_compositor *compositor,
 	struct wlr_renderer *renderer);
 
+/**
+ * Hold surface commits attaching a DMA-BUF until the buffer's implicit fences
+ * have signaled, instead of waiting for them during composition.
+ *
+ * With this enabled, a client whose rendering is late misses a frame instead
+ * of delaying the whole output. Returns false if the kernel doesn't support
+ * exporting fences from DMA-BUFs.
+ */
+bool wlr_compositor_set_wait_dmabuf_fences(struct wlr_compositor *compositor,
+	bool enabled);
+
 #endif
@@ -0,0 +1,90 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_FIFO_V1_H
+#define WLR_TYPES_WLR_FIFO_V1_H
+
+#include <stdbool.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/addon.h>
+
+struct wlr_output;
+
+struct wlr_fifo_manager_v1 {
+	struct wl_global *global;
+
+	struct {
+		struct wl_signal new_fifo; // struct wlr_fifo_v1
+		struct wl_signal destroy;
+	} events;
+
+	void *data;
+
+	// private state
+
+	struct wl_listener display_destroy;
+};
+
+struct wlr_fifo_v1_state {
+	bool set_barrier;
+};
+
+/**
+ * A FIFO object attached to a surface.
+ *
+ * A commit setting the barrier blocks later commits waiting on it until its
+ * contents have been latched by an output commit. The compositor should
+ * assign the output the surface is presented on with
+ * wlr_fifo_v1_set_output(). The barrier is cleared right away while the
+ * surface has no enabled output, and after a few refresh cycles without an
+ * output commit otherwise, so that hidden surfaces keep making progress.
+ */
+struct wlr_fifo_v1 {
+	struct wl_resource *resource;
+	struct wlr_surface *surface;
+	struct wlr_output *output; // may be NULL
+
+	struct wlr_fifo_v1_state pending, current;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	void *data;
+
+	// private state
+
+	struct wlr_addon addon;
+	struct wlr_surface_synced synced;
+
+	bool pending_wait_barrier;
+	bool barrier;
+	// Number of commits setting the barrier, counted when committed by the
+	// client and when applied
+	uint64_t requested_barriers, applied_barriers;
+
+	struct wl_list commits; // fifo_commit.link
+	struct wl_event_source *timer;
+
+	struct wl_listener surface_client_commit;
+	struct wl_listener surface_commit;
+	struct wl_listener output_commit;
+	struct wl_listener output_destroy;
+};
+
+struct wlr_fifo_manager_v1 *wlr_fifo_manager_v1_create(
+	struct wl_display *display, uint32_t version);
+
+/**
+ * Set the output the surface is presented on. output may be NULL.
+ */
+void wlr_fifo_v1_set_output(struct wlr_fifo_v1 *fifo,
+	struct wlr_output *output);
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_INPUT_LATENCY_H
+#define WLR_TYPES_WLR_INPUT_LATENCY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+/* Bucket i holds latencies in [2^i, 2^(i+1)) microseconds. */
+#define WLR_INPUT_LATENCY_BUCKETS 32
+
+/* Number of committed frames waiting for a present event. */
+#define WLR_INPUT_LATENCY_INFLIGHT_LEN 4
+
+struct wlr_output;
+
+struct wlr_input_latency_histogram {
+	uint64_t buckets[WLR_INPUT_LATENCY_BUCKETS];
+	uint64_t count;
+	uint64_t sum_usec, min_usec, max_usec;
+};
+
+struct wlr_input_latency_frame {
+	uint32_t commit_seq;
+	uint64_t input_usec; // 0 if the slot is unused
+};
+
+/**
+ * Measures the time between input events and the presentation of the first
+ * frame which was committed after they have been consumed, for a single
+ * output.
+ *
+ * Input timestamps are expected to be in microseconds on the output's
+ * presentation clock, which is CLOCK_MONOTONIC for all backends shipped with
+ * wlroots. The time_usec field of input device events satisfies this when
+ * it's set.
+ */
+struct wlr_input_latency_tracker {
+	struct wlr_output *output;
+
+	struct wlr_input_latency_histogram histogram;
+
+	struct {
+		struct wl_signal sample; // struct wlr_input_latency_sample_event
+		struct wl_signal destroy;
+	} events;
+
+	void *data;
+
+	// private state
+
+	uint64_t pending_input_usec; // 0 if no input since the last frame
+	struct wlr_input_latency_frame inflight[WLR_INPUT_LATENCY_INFLIGHT_LEN];
+	size_t inflight_next;
+
+	struct wl_listener output_commit;
+	struct wl_listener output_present;
+	struct wl_listener output_destroy;
+};
+
+struct wlr_input_latency_sample_event {
+	struct wlr_input_latency_tracker *tracker;
+	uint32_t commit_seq;
+	uint64_t input_usec, present_usec;
+	uint64_t latency_usec;
+};
+
+/**
+ * Create a tracker for the specified output. The tracker is destroyed along
+ * with the output.
+ */
+struct wlr_input_latency_tracker *wlr_input_latency_tracker_create(
+	struct wlr_output *output);
+void wlr_input_latency_tracker_destroy(struct wlr_input_latency_tracker *tracker);
+/**
+ * Notify the tracker that an input event affecting the output's contents has
+ * been consumed. The next frame committed on the output will be attributed to
+ * the latest such event.
+ */
+void wlr_input_latency_tracker_notify_input(
+	struct wlr_input_latency_tracker *tracker, uint64_t time_usec);
+/**
+ * Clear the histogram.
+ */
+void wlr_input_latency_tracker_reset(struct wlr_input_latency_tracker *tracker);
+
+#endif
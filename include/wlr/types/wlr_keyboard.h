@@ -97,6 +97,7 @@ struct wlr_keyboard {
 
 struct wlr_keyboard_key_event {
 	uint32_t time_msec;
+	uint64_t time_usec; // 0 if unknown
 	uint32_t keycode;
 	bool update_state; // if backend doesn't update modifiers on its own
 	enum wl_keyboard_key_state state;
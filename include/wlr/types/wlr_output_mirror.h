@@ -0,0 +1,61 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_OUTPUT_MIRROR_H
+#define WLR_TYPES_WLR_OUTPUT_MIRROR_H
+
+#include <stdbool.h>
+#include <wayland-server-core.h>
+
+struct wlr_buffer;
+struct wlr_output;
+
+/**
+ * Displays the contents of a source output on a mirror output.
+ *
+ * Each buffer committed on the source is presented on the mirror as well. The
+ * buffer is shared directly with the mirror when the mirror accepts it (same
+ * size, transform and a supported format), otherwise it's copied once, scaled
+ * to fit the mirror while preserving the aspect ratio.
+ *
+ * The compositor must not render or commit buffers on the mirror output
+ * itself while mirroring. The mirror needs to be enabled, and rendering needs
+ * to be initialized for it in case copies are necessary.
+ */
+struct wlr_output_mirror {
+	struct wlr_output *source, *mirror;
+
+	// Whether the last buffer presented on the mirror was shared with the
+	// source
+	bool zero_copy;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	void *data;
+
+	// private state
+
+	struct wlr_buffer *pending_buffer; // locked, may be NULL
+
+	struct wl_listener source_commit;
+	struct wl_listener source_destroy;
+	struct wl_listener mirror_frame;
+	struct wl_listener mirror_destroy;
+};
+
+/**
+ * Start mirroring the source output on the mirror output. Mirroring stops when
+ * either output is destroyed.
+ */
+struct wlr_output_mirror *wlr_output_mirror_create(struct wlr_output *source,
+	struct wlr_output *mirror);
+void wlr_output_mirror_destroy(struct wlr_output_mirror *mirror);
+
+#endif
@@ -48,6 +48,7 @@ struct wlr_pointer {
 struct wlr_pointer_motion_event {
 	struct wlr_pointer *pointer;
 	uint32_t time_msec;
+	uint64_t time_usec; // 0 if unknown
 	double delta_x, delta_y;
 	double unaccel_dx, unaccel_dy;
 };
@@ -55,6 +56,7 @@ struct wlr_pointer_motion_event {
 struct wlr_pointer_motion_absolute_event {
 	struct wlr_pointer *pointer;
 	uint32_t time_msec;
+	uint64_t time_usec; // 0 if unknown
 	// From 0..1
 	double x, y;
 };
@@ -62,6 +64,7 @@ struct wlr_pointer_motion_absolute_event {
 struct wlr_pointer_button_event {
 	struct wlr_pointer *pointer;
 	uint32_t time_msec;
+	uint64_t time_usec; // 0 if unknown
 	uint32_t button;
 	enum wl_pointer_button_state state;
 };
@@ -71,6 +74,7 @@ struct wlr_pointer_button_event {
 struct wlr_pointer_axis_event {
 	struct wlr_pointer *pointer;
 	uint32_t time_msec;
+	uint64_t time_usec; // 0 if unknown
 	enum wl_pointer_axis_source source;
 	enum wl_pointer_axis orientation;
 	enum wl_pointer_axis_relative_direction relative_direction;
@@ -108,6 +108,7 @@ struct wlr_scene {
 	enum wlr_scene_debug_damage_option debug_damage_option;
 	bool direct_scanout;
 	bool calculate_visibility;
+	int occluded_frame_interval_ms;
 };
 
 /** A scene-graph node displaying a single surface. */
@@ -160,6 +161,7 @@ struct wlr_scene_buffer {
 		struct wl_signal output_leave; // struct wlr_scene_output
 		struct wl_signal output_sample; // struct wlr_scene_output_sample_event
 		struct wl_signal frame_done; // struct timespec
+		struct wl_signal occlusion_update;
 	} events;
 
 	// May be NULL
@@ -173,6 +175,15 @@ struct wlr_scene_buffer {
 	 */
 	struct wlr_scene_output *primary_output;
 
+	/**
+	 * Whether this buffer isn't displayed on any output, because it's fully
+	 * occluded, outside of all outputs or disabled. Only tracked when occluded
+	 * frame throttling is enabled, see wlr_scene_set_occluded_frame_interval().
+	 * Updated when frame done events are sent, occlusion_update is emitted when
+	 * it changes.
+	 */
+	bool occluded;
+
 	float opacity;
 	enum wlr_scale_filter_mode filter_mode;
 	struct wlr_fbox src_box;
@@ -183,6 +194,7 @@ struct wlr_scene_buffer {
 	// private state
 
 	uint64_t active_outputs;
+	int64_t occluded_frame_done_msec;
 	struct wlr_texture *texture;
 	struct wlr_linux_dmabuf_feedback_v1_init_options prev_feedback_options;
 
@@ -316,6 +328,19 @@ struct wlr_scene *wlr_scene_create(void);
 void wlr_scene_set_linux_dmabuf_v1(struct wlr_scene *scene,
 	struct wlr_linux_dmabuf_v1 *linux_dmabuf_v1);
 
+/**
+ * Throttle frame done events for buffers which aren't displayed on any
+ * output.
+ *
+ * By default, such buffers don't receive frame done events at all. With a
+ * non-zero interval, wlr_scene_output_send_frame_done() sends them frame done
+ * events at most every interval_ms milliseconds, and keeps
+ * wlr_scene_buffer.occluded up to date. Compositors can use the
+ * occlusion_update event to suspend the corresponding xdg_toplevel.
+ */
+void wlr_scene_set_occluded_frame_interval(struct wlr_scene *scene,
+	int interval_ms);
+
 
 /**
  * Add a node displaying nothing but its children.
@@ -490,6 +515,28 @@ bool wlr_scene_output_commit(struct wlr_scene_output *scene_output,
 bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 	struct wlr_output_state *state, const struct wlr_scene_output_state_options *options);
 
+struct wlr_scene_output_state_batch_entry {
+	struct wlr_scene_output *scene_output;
+	struct wlr_output_state *state;
+
+	// Set by wlr_scene_output_build_states()
+	bool built;
+};
+
+/**
+ * Render and populate the states of several outputs of the same scene.
+ *
+ * The scene graph is walked once for all outputs. Outputs showing exactly the
+ * same contents as a previous entry (same position, resolution, scale and
+ * transform, e.g. mirrors) are not rendered again: the damaged region of the
+ * previous entry's buffer is copied instead.
+ *
+ * Returns true if all states have been built. Entries whose state has been
+ * built have their built field set.
+ */
+bool wlr_scene_output_build_states(
+	struct wlr_scene_output_state_batch_entry *entries, size_t entries_len);
+
 /**
  * Retrieve the duration in nanoseconds between the last wlr_scene_output_commit() call and the end
  * of its operations, including those on the GPU that may have finished after the call returned.
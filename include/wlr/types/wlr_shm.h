@@ -25,14 +25,33 @@ struct wlr_renderer;
 struct wlr_shm {
 	struct wl_global *global;
 
+	struct {
+		struct wl_signal quota_exceeded; // struct wlr_shm_quota_exceeded_event
+	} events;
+
 	// private state
 
 	uint32_t *formats;
 	size_t formats_len;
 
+	size_t client_quota; // 0 means unlimited
+	struct wl_list clients; // wlr_shm_client.link
+
 	struct wl_listener display_destroy;
 };
 
+/**
+ * Emitted when a client tries to create or resize a wl_shm_pool beyond the
+ * quota set via wlr_shm_set_client_quota(). The request is refused with a
+ * protocol error right after the signal is emitted.
+ */
+struct wlr_shm_quota_exceeded_event {
+	struct wl_client *client;
+	size_t mapped_size; // bytes currently mapped for the client
+	size_t requested_size; // additional bytes the client asked for
+	size_t quota;
+};
+
 /**
  * Create the wl_shm global.
  *
@@ -50,4 +69,19 @@ struct wlr_shm *wlr_shm_create(struct wl_display *display, uint32_t version,
 struct wlr_shm *wlr_shm_create_with_renderer(struct wl_display *display,
 	uint32_t version, struct wlr_renderer *renderer);
 
+/**
+ * Limit the total size of the wl_shm_pool mappings a single client can hold,
+ * in bytes. A quota of zero disables the limit (the default).
+ *
+ * Pools which already exist are not affected, the quota is only checked when
+ * a pool is created or resized.
+ */
+void wlr_shm_set_client_quota(struct wlr_shm *shm, size_t quota);
+
+/**
+ * Get the total size of the wl_shm_pool mappings currently held by a client,
+ * in bytes.
+ */
+size_t wlr_shm_get_client_usage(struct wlr_shm *shm, struct wl_client *client);
+
 #endif
@@ -37,6 +37,7 @@ struct wlr_touch {
 struct wlr_touch_down_event {
 	struct wlr_touch *touch;
 	uint32_t time_msec;
+	uint64_t time_usec; // 0 if unknown
 	int32_t touch_id;
 	// From 0..1
 	double x, y;
@@ -45,12 +46,14 @@ struct wlr_touch_down_event {
 struct wlr_touch_up_event {
 	struct wlr_touch *touch;
 	uint32_t time_msec;
+	uint64_t time_usec; // 0 if unknown
 	int32_t touch_id;
 };
 
 struct wlr_touch_motion_event {
 	struct wlr_touch *touch;
 	uint32_t time_msec;
+	uint64_t time_usec; // 0 if unknown
 	int32_t touch_id;
 	// From 0..1
 	double x, y;
@@ -59,6 +62,7 @@ struct wlr_touch_motion_event {
 struct wlr_touch_cancel_event {
 	struct wlr_touch *touch;
 	uint32_t time_msec;
+	uint64_t time_usec; // 0 if unknown
 	int32_t touch_id;
 };
 
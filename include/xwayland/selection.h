@@ -6,6 +6,12 @@
 #include <wayland-util.h>
 
 #define INCR_CHUNK_SIZE (64 * 1024)
+// Upper bound for the size of chunks sent to X11 clients, grown from
+// INCR_CHUNK_SIZE while the Wayland client produces data faster
+#define INCR_MAX_CHUNK_SIZE (1024 * 1024)
+// Maximum amount of data received from X11 clients and buffered for a
+// Wayland client
+#define INCR_MAX_BUFFERED_SIZE (4 * 1024 * 1024)
 
 #define XDND_VERSION 5
 
@@ -29,11 +35,14 @@ struct wlr_xwm_selection_transfer {
 
 	// when sending to x11
 	xcb_selection_request_event_t request;
+	size_t chunk_size;
 
 	// when receiving from x11
-	int property_start;
+	int property_start; // offset in property_reply, or source_data if incr
 	xcb_get_property_reply_t *property_reply;
 	xcb_window_t incoming_window;
+	bool incr_done; // the X11 client has sent the last chunk
+	bool incr_chunk_pending; // a chunk is waiting for buffer space
 };
 
 struct wlr_xwm_selection {
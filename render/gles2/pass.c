@@ -7,8 +7,6 @@
 #include "render/gles2.h"
 #include "types/wlr_matrix.h"
 
-#define MAX_QUADS 86 // 4kb
-
 static const struct wlr_render_pass_impl render_pass_impl;
 
 static struct wlr_gles2_render_pass *get_render_pass(struct wlr_render_pass *wlr_pass) {
@@ -17,11 +15,128 @@ static struct wlr_gles2_render_pass *get_render_pass(struct wlr_render_pass *wlr
 	return pass;
 }
 
+static void setup_blending(enum wlr_render_blend_mode mode) {
+	switch (mode) {
+	case WLR_RENDER_BLEND_MODE_PREMULTIPLIED:
+		glEnable(GL_BLEND);
+		break;
+	case WLR_RENDER_BLEND_MODE_NONE:
+		glDisable(GL_BLEND);
+		break;
+	}
+}
+
+static void setup_filtering(GLenum target, enum wlr_scale_filter_mode mode) {
+	switch (mode) {
+	case WLR_SCALE_FILTER_BILINEAR:
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		break;
+	case WLR_SCALE_FILTER_NEAREST:
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		break;
+	}
+}
+
+static void flush_batch(struct wlr_gles2_render_pass *pass) {
+	struct wlr_gles2_renderer *renderer = pass->buffer->renderer;
+	const struct wlr_gles2_batch_state *state = &pass->batch_state;
+
+	size_t stride = 4 * sizeof(GLfloat);
+	size_t verts_len = pass->batch_verts.size / stride;
+	if (verts_len == 0) {
+		return;
+	}
+	const GLfloat *verts = pass->batch_verts.data;
+
+	push_gles2_debug(renderer);
+	setup_blending(state->blend_mode);
+
+	GLint pos_attrib, texcoord_attrib = -1;
+	const struct wlr_gles2_tex_shader *shader = state->tex_shader;
+	if (shader != NULL) {
+		glUseProgram(shader->program);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(state->target, state->tex);
+		setup_filtering(state->target, state->filter_mode);
+
+		glUniform1i(shader->tex, 0);
+		glUniform1f(shader->alpha, state->alpha);
+		glUniformMatrix3fv(shader->proj, 1, GL_FALSE, pass->projection_matrix);
+
+		pos_attrib = shader->pos_attrib;
+		texcoord_attrib = shader->texcoord_attrib;
+	} else {
+		const struct wlr_render_color *color = &state->color;
+		glUseProgram(renderer->shaders.quad.program);
+		glUniformMatrix3fv(renderer->shaders.quad.proj, 1, GL_FALSE,
+			pass->projection_matrix);
+		glUniform4f(renderer->shaders.quad.color,
+			color->r, color->g, color->b, color->a);
+
+		pos_attrib = renderer->shaders.quad.pos_attrib;
+	}
+
+	glEnableVertexAttribArray(pos_attrib);
+	glVertexAttribPointer(pos_attrib, 2, GL_FLOAT, GL_FALSE, stride, verts);
+	if (texcoord_attrib >= 0) {
+		glEnableVertexAttribArray(texcoord_attrib);
+		glVertexAttribPointer(texcoord_attrib, 2, GL_FLOAT, GL_FALSE,
+			stride, verts + 2);
+	}
+
+	glDrawArrays(GL_TRIANGLES, 0, verts_len);
+
+	if (texcoord_attrib >= 0) {
+		glDisableVertexAttribArray(texcoord_attrib);
+	}
+	glDisableVertexAttribArray(pos_attrib);
+
+	if (shader != NULL) {
+		glBindTexture(state->target, 0);
+	}
+
+	pop_gles2_debug(renderer);
+
+	pass->batch_verts.size = 0;
+}
+
+static bool batch_state_equal(const struct wlr_gles2_batch_state *a,
+		const struct wlr_gles2_batch_state *b) {
+	if (a->tex_shader != b->tex_shader || a->blend_mode != b->blend_mode) {
+		return false;
+	}
+	if (a->tex_shader != NULL) {
+		return a->target == b->target && a->tex == b->tex &&
+			a->filter_mode == b->filter_mode && a->alpha == b->alpha;
+	}
+	return a->color.r == b->color.r && a->color.g == b->color.g &&
+		a->color.b == b->color.b && a->color.a == b->color.a;
+}
+
+/**
+ * Start a new batch if the state differs from the pending one.
+ */
+static void set_batch_state(struct wlr_gles2_render_pass *pass,
+		const struct wlr_gles2_batch_state *state) {
+	if (pass->batch_verts.size > 0 &&
+			batch_state_equal(&pass->batch_state, state)) {
+		return;
+	}
+	flush_batch(pass);
+	pass->batch_state = *state;
+}
+
 static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 	struct wlr_gles2_render_pass *pass = get_render_pass(wlr_pass);
 	struct wlr_gles2_renderer *renderer = pass->buffer->renderer;
 	struct wlr_gles2_render_timer *timer = pass->timer;
 
+	flush_batch(pass);
+	wl_array_release(&pass->batch_verts);
+
 	push_gles2_debug(renderer);
 
 	if (timer) {
@@ -48,7 +163,31 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 	return true;
 }
 
-static void render(const struct wlr_box *box, const pixman_region32_t *clip, GLint attrib) {
+static void push_vertex(GLfloat **verts, const struct wlr_box *box,
+		const float tex_matrix[static 9], int32_t x, int32_t y) {
+	GLfloat u = (GLfloat)(x - box->x) / box->width;
+	GLfloat v = (GLfloat)(y - box->y) / box->height;
+
+	GLfloat *vert = *verts;
+	vert[0] = x;
+	vert[1] = y;
+	if (tex_matrix != NULL) {
+		vert[2] = tex_matrix[0] * u + tex_matrix[1] * v + tex_matrix[2];
+		vert[3] = tex_matrix[3] * u + tex_matrix[4] * v + tex_matrix[5];
+	} else {
+		vert[2] = u;
+		vert[3] = v;
+	}
+	*verts += 4;
+}
+
+/**
+ * Append two triangles per clip rectangle to the pending batch. Texture
+ * coordinates are computed by applying tex_matrix to the position relative to
+ * the box.
+ */
+static void render(struct wlr_gles2_render_pass *pass, const struct wlr_box *box,
+		const pixman_region32_t *clip, const float *tex_matrix) {
 	pixman_region32_t region;
 	pixman_region32_init_rect(&region, box->x, box->y, box->width, box->height);
 
@@ -63,52 +202,30 @@ static void render(const struct wlr_box *box, const pixman_region32_t *clip, GLi
 		return;
 	}
 
-	glEnableVertexAttribArray(attrib);
-
-	for (int i = 0; i < rects_len;) {
-		int batch = rects_len - i < MAX_QUADS ? rects_len - i : MAX_QUADS;
-		int batch_end = batch + i;
-
-		size_t vert_index = 0;
-		GLfloat verts[MAX_QUADS * 6 * 2];
-		for (; i < batch_end; i++) {
-			const pixman_box32_t *rect = &rects[i];
-
-			verts[vert_index++] = (GLfloat)(rect->x1 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y1 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x2 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y1 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x1 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y2 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x2 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y1 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x2 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y2 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x1 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y2 - box->y) / box->height;
-		}
-
-		glVertexAttribPointer(attrib, 2, GL_FLOAT, GL_FALSE, 0, verts);
-		glDrawArrays(GL_TRIANGLES, 0, batch * 6);
+	GLfloat *verts = wl_array_add(&pass->batch_verts,
+		rects_len * 6 * 4 * sizeof(GLfloat));
+	if (verts == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		pixman_region32_fini(&region);
+		return;
 	}
 
-	glDisableVertexAttribArray(attrib);
+	for (int i = 0; i < rects_len; i++) {
+		const pixman_box32_t *rect = &rects[i];
 
-	pixman_region32_fini(&region);
-}
+		push_vertex(&verts, box, tex_matrix, rect->x1, rect->y1);
+		push_vertex(&verts, box, tex_matrix, rect->x2, rect->y1);
+		push_vertex(&verts, box, tex_matrix, rect->x1, rect->y2);
+		push_vertex(&verts, box, tex_matrix, rect->x2, rect->y1);
+		push_vertex(&verts, box, tex_matrix, rect->x2, rect->y2);
+		push_vertex(&verts, box, tex_matrix, rect->x1, rect->y2);
+	}
 
-static void set_proj_matrix(GLint loc, float proj[9], const struct wlr_box *box) {
-	float gl_matrix[9];
-	wlr_matrix_identity(gl_matrix);
-	wlr_matrix_translate(gl_matrix, box->x, box->y);
-	wlr_matrix_scale(gl_matrix, box->width, box->height);
-	wlr_matrix_multiply(gl_matrix, proj, gl_matrix);
-	glUniformMatrix3fv(loc, 1, GL_FALSE, gl_matrix);
+	pixman_region32_fini(&region);
 }
 
-static void set_tex_matrix(GLint loc, enum wl_output_transform trans,
-		const struct wlr_fbox *box) {
-	float tex_matrix[9];
+static void get_tex_matrix(float tex_matrix[static 9],
+		enum wl_output_transform trans, const struct wlr_fbox *box) {
 	wlr_matrix_identity(tex_matrix);
 	wlr_matrix_translate(tex_matrix, box->x, box->y);
 	wlr_matrix_scale(tex_matrix, box->width, box->height);
@@ -122,19 +239,6 @@ static void set_tex_matrix(GLint loc, enum wl_output_transform trans,
 		wlr_matrix_transform(tex_matrix, trans);
 	}
 	wlr_matrix_translate(tex_matrix, -.5, -.5);
-
-	glUniformMatrix3fv(loc, 1, GL_FALSE, tex_matrix);
-}
-
-static void setup_blending(enum wlr_render_blend_mode mode) {
-	switch (mode) {
-	case WLR_RENDER_BLEND_MODE_PREMULTIPLIED:
-		glEnable(GL_BLEND);
-		break;
-	case WLR_RENDER_BLEND_MODE_NONE:
-		glDisable(GL_BLEND);
-		break;
-	}
 }
 
 static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
@@ -174,57 +278,38 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 	src_fbox.width /= options->texture->width;
 	src_fbox.height /= options->texture->height;
 
-	push_gles2_debug(renderer);
-	setup_blending(!texture->has_alpha && alpha == 1.0 ?
-		WLR_RENDER_BLEND_MODE_NONE : options->blend_mode);
-
-	glUseProgram(shader->program);
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(texture->target, texture->tex);
-
-	switch (options->filter_mode) {
-	case WLR_SCALE_FILTER_BILINEAR:
-		glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		break;
-	case WLR_SCALE_FILTER_NEAREST:
-		glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		break;
-	}
-
-	glUniform1i(shader->tex, 0);
-	glUniform1f(shader->alpha, alpha);
-	set_proj_matrix(shader->proj, pass->projection_matrix, &dst_box);
-	set_tex_matrix(shader->tex_proj, options->transform, &src_fbox);
+	struct wlr_gles2_batch_state state = {
+		.tex_shader = shader,
+		.target = texture->target,
+		.tex = texture->tex,
+		.filter_mode = options->filter_mode,
+		.blend_mode = !texture->has_alpha && alpha == 1.0 ?
+			WLR_RENDER_BLEND_MODE_NONE : options->blend_mode,
+		.alpha = alpha,
+	};
+	set_batch_state(pass, &state);
 
-	render(&dst_box, options->clip, shader->pos_attrib);
-
-	glBindTexture(texture->target, 0);
-	pop_gles2_debug(renderer);
+	float tex_matrix[9];
+	get_tex_matrix(tex_matrix, options->transform, &src_fbox);
+	render(pass, &dst_box, options->clip, tex_matrix);
 }
 
 static void render_pass_add_rect(struct wlr_render_pass *wlr_pass,
 		const struct wlr_render_rect_options *options) {
 	struct wlr_gles2_render_pass *pass = get_render_pass(wlr_pass);
-	struct wlr_gles2_renderer *renderer = pass->buffer->renderer;
 
 	const struct wlr_render_color *color = &options->color;
 	struct wlr_box box;
 	wlr_render_rect_options_get_box(options, pass->buffer->buffer, &box);
 
-	push_gles2_debug(renderer);
-	setup_blending(color->a == 1.0 ? WLR_RENDER_BLEND_MODE_NONE : options->blend_mode);
-
-	glUseProgram(renderer->shaders.quad.program);
+	struct wlr_gles2_batch_state state = {
+		.blend_mode = color->a == 1.0 ?
+			WLR_RENDER_BLEND_MODE_NONE : options->blend_mode,
+		.color = *color,
+	};
+	set_batch_state(pass, &state);
 
-	set_proj_matrix(renderer->shaders.quad.proj, pass->projection_matrix, &box);
-	glUniform4f(renderer->shaders.quad.color, color->r, color->g, color->b, color->a);
-
-	render(&box, options->clip, renderer->shaders.quad.pos_attrib);
-
-	pop_gles2_debug(renderer);
+	render(pass, &box, options->clip, NULL);
 }
 
 static const struct wlr_render_pass_impl render_pass_impl = {
@@ -275,6 +360,7 @@ struct wlr_gles2_render_pass *begin_gles2_buffer_pass(struct wlr_gles2_buffer *b
 	pass->buffer = buffer;
 	pass->timer = timer;
 	pass->prev_ctx = *prev_ctx;
+	wl_array_init(&pass->batch_verts);
 
 	matrix_projection(pass->projection_matrix, wlr_buffer->width, wlr_buffer->height,
 		WL_OUTPUT_TRANSFORM_FLIPPED_180);
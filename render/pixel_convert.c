@@ -0,0 +1,178 @@
+#include <drm_fourcc.h>
+#include <string.h>
+#include "render/pixel_convert.h"
+
+/*
+ * The row kernels below only use simple per-pixel integer operations on
+ * 32-bit words, without branches depending on the pixel values. Compilers
+ * vectorize these loops for the target instruction set.
+ */
+
+enum pixel_layout_kind {
+	PIXEL_LAYOUT_8888,
+	PIXEL_LAYOUT_2101010,
+	PIXEL_LAYOUT_565,
+};
+
+struct pixel_layout {
+	uint32_t format;
+	enum pixel_layout_kind kind;
+	bool bgr; // blue in the most significant color channel
+	bool alpha;
+};
+
+static const struct pixel_layout layouts[] = {
+	{ DRM_FORMAT_XRGB8888, PIXEL_LAYOUT_8888, false, false },
+	{ DRM_FORMAT_ARGB8888, PIXEL_LAYOUT_8888, false, true },
+	{ DRM_FORMAT_XBGR8888, PIXEL_LAYOUT_8888, true, false },
+	{ DRM_FORMAT_ABGR8888, PIXEL_LAYOUT_8888, true, true },
+	{ DRM_FORMAT_XRGB2101010, PIXEL_LAYOUT_2101010, false, false },
+	{ DRM_FORMAT_ARGB2101010, PIXEL_LAYOUT_2101010, false, true },
+	{ DRM_FORMAT_XBGR2101010, PIXEL_LAYOUT_2101010, true, false },
+	{ DRM_FORMAT_ABGR2101010, PIXEL_LAYOUT_2101010, true, true },
+	{ DRM_FORMAT_RGB565, PIXEL_LAYOUT_565, false, false },
+	{ DRM_FORMAT_BGR565, PIXEL_LAYOUT_565, true, false },
+};
+
+typedef void (*convert_row_func)(void *dst, const void *src, size_t width,
+	bool swap, bool src_alpha, bool dst_alpha);
+
+static const struct pixel_layout *get_layout(uint32_t format) {
+	for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+		if (layouts[i].format == format) {
+			return &layouts[i];
+		}
+	}
+	return NULL;
+}
+
+static void convert_row_copy(void *dst, const void *src, size_t width,
+		bool swap, bool src_alpha, bool dst_alpha) {
+	memcpy(dst, src, width * sizeof(uint32_t));
+}
+
+static void convert_row_8888_to_8888(void *dst, const void *src, size_t width,
+		bool swap, bool src_alpha, bool dst_alpha) {
+	const uint32_t *s = src;
+	uint32_t *d = dst;
+	uint32_t alpha = dst_alpha && !src_alpha ? 0xFF000000 : 0;
+	for (size_t i = 0; i < width; i++) {
+		uint32_t p = s[i];
+		if (swap) {
+			p = (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+		}
+		d[i] = p | alpha;
+	}
+}
+
+static void convert_row_8888_to_565(void *dst, const void *src, size_t width,
+		bool swap, bool src_alpha, bool dst_alpha) {
+	const uint32_t *s = src;
+	uint16_t *d = dst;
+	int hi_shift = swap ? 0 : 16, lo_shift = swap ? 16 : 0;
+	for (size_t i = 0; i < width; i++) {
+		uint32_t p = s[i];
+		uint32_t hi = (p >> hi_shift) & 0xFF;
+		uint32_t mid = (p >> 8) & 0xFF;
+		uint32_t lo = (p >> lo_shift) & 0xFF;
+		d[i] = (uint16_t)(((hi >> 3) << 11) | ((mid >> 2) << 5) | (lo >> 3));
+	}
+}
+
+static void convert_row_8888_to_2101010(void *dst, const void *src,
+		size_t width, bool swap, bool src_alpha, bool dst_alpha) {
+	const uint32_t *s = src;
+	uint32_t *d = dst;
+	int hi_shift = swap ? 0 : 16, lo_shift = swap ? 16 : 0;
+	for (size_t i = 0; i < width; i++) {
+		uint32_t p = s[i];
+		uint32_t hi = (p >> hi_shift) & 0xFF;
+		uint32_t mid = (p >> 8) & 0xFF;
+		uint32_t lo = (p >> lo_shift) & 0xFF;
+		uint32_t a = src_alpha ? p >> 30 : 0x3;
+		// Replicate the most significant bits to fill the 10-bit channels
+		hi = (hi << 2) | (hi >> 6);
+		mid = (mid << 2) | (mid >> 6);
+		lo = (lo << 2) | (lo >> 6);
+		d[i] = (a << 30) | (hi << 20) | (mid << 10) | lo;
+	}
+}
+
+static void convert_row_2101010_to_8888(void *dst, const void *src,
+		size_t width, bool swap, bool src_alpha, bool dst_alpha) {
+	const uint32_t *s = src;
+	uint32_t *d = dst;
+	int hi_shift = swap ? 0 : 16, lo_shift = swap ? 16 : 0;
+	for (size_t i = 0; i < width; i++) {
+		uint32_t p = s[i];
+		uint32_t hi = (p >> 22) & 0xFF;
+		uint32_t mid = (p >> 12) & 0xFF;
+		uint32_t lo = (p >> 2) & 0xFF;
+		uint32_t a = src_alpha ? (p >> 30) * 0x55 : 0xFF;
+		d[i] = (a << 24) | (hi << hi_shift) | (mid << 8) | (lo << lo_shift);
+	}
+}
+
+static convert_row_func get_convert_row_func(const struct pixel_layout *dst,
+		const struct pixel_layout *src) {
+	if (dst == NULL || src == NULL) {
+		return NULL;
+	}
+
+	bool swap = dst->bgr != src->bgr;
+	switch (src->kind) {
+	case PIXEL_LAYOUT_8888:
+		switch (dst->kind) {
+		case PIXEL_LAYOUT_8888:
+			if (!swap && (src->alpha || !dst->alpha)) {
+				return convert_row_copy;
+			}
+			return convert_row_8888_to_8888;
+		case PIXEL_LAYOUT_2101010:
+			return convert_row_8888_to_2101010;
+		case PIXEL_LAYOUT_565:
+			return convert_row_8888_to_565;
+		}
+		break;
+	case PIXEL_LAYOUT_2101010:
+		switch (dst->kind) {
+		case PIXEL_LAYOUT_8888:
+			return convert_row_2101010_to_8888;
+		case PIXEL_LAYOUT_2101010:
+			if (!swap && (src->alpha || !dst->alpha)) {
+				return convert_row_copy;
+			}
+			return NULL;
+		case PIXEL_LAYOUT_565:
+			return NULL;
+		}
+		break;
+	case PIXEL_LAYOUT_565:
+		break;
+	}
+	return NULL;
+}
+
+bool pixel_convert_supported(uint32_t dst_format, uint32_t src_format) {
+	return get_convert_row_func(get_layout(dst_format),
+		get_layout(src_format)) != NULL;
+}
+
+bool pixel_convert(void *dst, uint32_t dst_format, size_t dst_stride,
+		const void *src, uint32_t src_format, size_t src_stride,
+		uint32_t width, uint32_t height) {
+	const struct pixel_layout *dst_layout = get_layout(dst_format);
+	const struct pixel_layout *src_layout = get_layout(src_format);
+	convert_row_func convert_row = get_convert_row_func(dst_layout, src_layout);
+	if (convert_row == NULL) {
+		return false;
+	}
+
+	bool swap = dst_layout->bgr != src_layout->bgr;
+	for (uint32_t y = 0; y < height; y++) {
+		convert_row((char *)dst + y * dst_stride,
+			(const char *)src + y * src_stride, width,
+			swap, src_layout->alpha, dst_layout->alpha);
+	}
+	return true;
+}
@@ -7,6 +7,7 @@
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
 
+#include "render/pixel_convert.h"
 #include "render/pixman.h"
 #include "types/wlr_buffer.h"
 
@@ -104,13 +105,33 @@ static bool texture_read_pixels(struct wlr_texture *wlr_texture,
 
 	void *p = wlr_texture_read_pixel_options_get_data(options);
 
-	pixman_image_t *dst = pixman_image_create_bits_no_clear(fmt,
-			src.width, src.height, p, options->stride);
+	if (texture->buffer != NULL && !begin_pixman_data_ptr_access(texture->buffer,
+			&texture->image, WLR_BUFFER_DATA_PTR_ACCESS_READ)) {
+		return false;
+	}
 
-	pixman_image_composite32(PIXMAN_OP_SRC, texture->image, NULL, dst,
-			src.x, src.y, 0, 0, 0, 0, src.width, src.height);
+	uint32_t src_format = texture->format_info->drm_format;
+	if (pixel_convert_supported(options->format, src_format)) {
+		// Plain copies and common conversions are faster without a composite
+		size_t src_stride = pixman_image_get_stride(texture->image);
+		const char *src_data = (const char *)pixman_image_get_data(texture->image) +
+			src.y * src_stride +
+			pixel_format_info_min_stride(texture->format_info, src.x);
+		pixel_convert(p, options->format, options->stride,
+			src_data, src_format, src_stride, src.width, src.height);
+	} else {
+		pixman_image_t *dst = pixman_image_create_bits_no_clear(fmt,
+				src.width, src.height, p, options->stride);
+
+		pixman_image_composite32(PIXMAN_OP_SRC, texture->image, NULL, dst,
+				src.x, src.y, 0, 0, 0, 0, src.width, src.height);
+
+		pixman_image_unref(dst);
+	}
 
-	pixman_image_unref(dst);
+	if (texture->buffer != NULL) {
+		wlr_buffer_end_data_ptr_access(texture->buffer);
+	}
 
 	return true;
 }
@@ -14,6 +14,9 @@ static struct wlr_vk_render_pass *get_render_pass(struct wlr_render_pass *wlr_pa
 	return pass;
 }
 
+// How many operations ahead of the current one are considered for merging
+#define OP_MERGE_WINDOW 64
+
 static void bind_pipeline(struct wlr_vk_render_pass *pass, VkPipeline pipeline) {
 	if (pipeline == pass->bound_pipeline) {
 		return;
@@ -21,6 +24,20 @@ static void bind_pipeline(struct wlr_vk_render_pass *pass, VkPipeline pipeline)
 
 	vkCmdBindPipeline(pass->command_buffer->vk, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 	pass->bound_pipeline = pipeline;
+	pass->renderer->stats.pipeline_binds++;
+}
+
+static void bind_descriptor_set(struct wlr_vk_render_pass *pass,
+		VkPipelineLayout layout, VkDescriptorSet ds) {
+	if (layout == pass->bound_layout && ds == pass->bound_ds) {
+		return;
+	}
+
+	vkCmdBindDescriptorSets(pass->command_buffer->vk,
+		VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &ds, 0, NULL);
+	pass->bound_layout = layout;
+	pass->bound_ds = ds;
+	pass->renderer->stats.descriptor_set_binds++;
 }
 
 static void get_clip_region(struct wlr_vk_render_pass *pass,
@@ -62,6 +79,150 @@ static void mat3_to_mat4(const float mat3[9], float mat4[4][4]) {
 	mat4[3][3] = 1.f;
 }
 
+static void render_pass_finish(struct wlr_vk_render_pass *pass) {
+	wlr_buffer_unlock(pass->render_buffer->wlr_buffer);
+	rect_union_finish(&pass->updated_region);
+	wl_array_release(&pass->ops);
+	wl_array_release(&pass->rects);
+	free(pass);
+}
+
+static void emit_op(struct wlr_vk_render_pass *pass,
+		const struct wlr_vk_render_op *op) {
+	VkCommandBuffer cb = pass->command_buffer->vk;
+	const VkRect2D *rects = (const VkRect2D *)pass->rects.data + op->rects_offset;
+
+	switch (op->type) {
+	case WLR_VK_RENDER_OP_DRAW:;
+		VkPipelineLayout layout = op->pipe->layout->vk;
+		bind_pipeline(pass, op->pipe->vk);
+		if (op->ds != VK_NULL_HANDLE) {
+			bind_descriptor_set(pass, layout, op->ds);
+		}
+
+		vkCmdPushConstants(cb, layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+			sizeof(op->vert_pcr_data), &op->vert_pcr_data);
+		vkCmdPushConstants(cb, layout, VK_SHADER_STAGE_FRAGMENT_BIT,
+			sizeof(op->vert_pcr_data), op->frag_pcr_size, op->frag_pcr_data);
+
+		for (size_t i = 0; i < op->rects_len; i++) {
+			vkCmdSetScissor(cb, 0, 1, &rects[i]);
+			vkCmdDraw(cb, 4, 1, 0, 0);
+		}
+		pass->renderer->stats.draws += op->rects_len;
+		break;
+	case WLR_VK_RENDER_OP_CLEAR:
+		for (size_t i = 0; i < op->rects_len; i++) {
+			vkCmdSetScissor(cb, 0, 1, &rects[i]);
+			vkCmdClearAttachments(cb, 1, &op->clear_att, 1, &op->clear_rect);
+		}
+		break;
+	}
+}
+
+static bool op_can_merge(const struct wlr_vk_render_op *a,
+		const struct wlr_vk_render_op *b) {
+	return a->type == WLR_VK_RENDER_OP_DRAW &&
+		b->type == WLR_VK_RENDER_OP_DRAW &&
+		a->pipe == b->pipe && a->ds == b->ds;
+}
+
+static bool boxes_intersect(const pixman_box32_t *a, const pixman_box32_t *b) {
+	return a->x1 < b->x2 && b->x1 < a->x2 && a->y1 < b->y2 && b->y1 < a->y2;
+}
+
+/**
+ * Emit all recorded operations.
+ *
+ * After each draw, later operations using the same pipeline and descriptor
+ * set are pulled forward if they don't overlap any of the operations they
+ * would skip over: operations touching disjoint areas can be re-ordered
+ * freely, and this saves pipeline and descriptor set binds.
+ */
+static bool emit_ops(struct wlr_vk_render_pass *pass) {
+	const struct wlr_vk_render_op *ops = pass->ops.data;
+	size_t ops_len = pass->ops.size / sizeof(*ops);
+	if (ops_len == 0) {
+		return true;
+	}
+
+	bool *emitted = calloc(ops_len, sizeof(*emitted));
+	if (emitted == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+
+	for (size_t i = 0; i < ops_len; i++) {
+		if (emitted[i]) {
+			continue;
+		}
+		emit_op(pass, &ops[i]);
+		emitted[i] = true;
+
+		size_t end = i + 1 + OP_MERGE_WINDOW;
+		if (end > ops_len) {
+			end = ops_len;
+		}
+		for (size_t j = i + 1; j < end; j++) {
+			if (emitted[j] || !op_can_merge(&ops[i], &ops[j])) {
+				continue;
+			}
+
+			bool blocked = false;
+			for (size_t k = i + 1; k < j; k++) {
+				if (!emitted[k] && boxes_intersect(&ops[k].bounds, &ops[j].bounds)) {
+					blocked = true;
+					break;
+				}
+			}
+			if (blocked) {
+				continue;
+			}
+
+			emit_op(pass, &ops[j]);
+			emitted[j] = true;
+		}
+	}
+
+	free(emitted);
+	return true;
+}
+
+/**
+ * Append a new operation to the pass, with one scissor rect per clip
+ * rectangle. Returns NULL on failure.
+ */
+static struct wlr_vk_render_op *record_op(struct wlr_vk_render_pass *pass,
+		enum wlr_vk_render_op_type type, const pixman_region32_t *clip) {
+	int clip_rects_len;
+	const pixman_box32_t *clip_rects = pixman_region32_rectangles(clip, &clip_rects_len);
+	if (clip_rects_len == 0) {
+		return NULL;
+	}
+
+	size_t rects_offset = pass->rects.size / sizeof(VkRect2D);
+	VkRect2D *rects = wl_array_add(&pass->rects, clip_rects_len * sizeof(*rects));
+	struct wlr_vk_render_op *op = wl_array_add(&pass->ops, sizeof(*op));
+	if (rects == NULL || op == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		pass->failed = true;
+		return NULL;
+	}
+
+	for (int i = 0; i < clip_rects_len; i++) {
+		convert_pixman_box_to_vk_rect(&clip_rects[i], &rects[i]);
+	}
+
+	*op = (struct wlr_vk_render_op){
+		.type = type,
+		.rects_offset = rects_offset,
+		.rects_len = clip_rects_len,
+		.bounds = *pixman_region32_extents(clip),
+	};
+	pass->renderer->stats.ops++;
+	return op;
+}
+
 static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 	struct wlr_vk_render_pass *pass = get_render_pass(wlr_pass);
 	struct wlr_vk_renderer *renderer = pass->renderer;
@@ -75,6 +236,10 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 		goto error;
 	}
 
+	if (!emit_ops(pass)) {
+		goto error;
+	}
+
 	if (vulkan_record_stage_cb(renderer) == VK_NULL_HANDLE) {
 		goto error;
 	}
@@ -104,9 +269,8 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 		bind_pipeline(pass, render_buffer->render_setup->output_pipe);
 		vkCmdPushConstants(render_cb->vk, renderer->output_pipe_layout,
 			VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(vert_pcr_data), &vert_pcr_data);
-		vkCmdBindDescriptorSets(render_cb->vk,
-			VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->output_pipe_layout,
-			0, 1, &render_buffer->blend_descriptor_set, 0, NULL);
+		bind_descriptor_set(pass, renderer->output_pipe_layout,
+			render_buffer->blend_descriptor_set);
 
 		const pixman_region32_t *clip = rect_union_evaluate(&pass->updated_region);
 		int clip_rects_len;
@@ -397,18 +561,14 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 		wlr_log(WLR_ERROR, "Failed to sync render buffer");
 	}
 
-	wlr_buffer_unlock(render_buffer->wlr_buffer);
-	rect_union_finish(&pass->updated_region);
-	free(pass);
+	render_pass_finish(pass);
 	return true;
 
 error:
 	free(render_wait);
 	vulkan_reset_command_buffer(stage_cb);
 	vulkan_reset_command_buffer(render_cb);
-	wlr_buffer_unlock(render_buffer->wlr_buffer);
-	rect_union_finish(&pass->updated_region);
-	free(pass);
+	render_pass_finish(pass);
 
 	if (device_lost) {
 		wl_signal_emit_mutable(&renderer->wlr_renderer.events.lost, NULL);
@@ -435,7 +595,6 @@ static void render_pass_mark_box_updated(struct wlr_vk_render_pass *pass,
 static void render_pass_add_rect(struct wlr_render_pass *wlr_pass,
 		const struct wlr_render_rect_options *options) {
 	struct wlr_vk_render_pass *pass = get_render_pass(wlr_pass);
-	VkCommandBuffer cb = pass->command_buffer->vk;
 
 	// Input color values are given in sRGB space, shader expects
 	// them in linear space. The shader does all computation in linear
@@ -490,28 +649,28 @@ static void render_pass_add_rect(struct wlr_render_pass *wlr_pass,
 			break;
 		}
 
-		struct wlr_vk_vert_pcr_data vert_pcr_data = {
+		pixman_region32_intersect_rect(&clip, &clip,
+			box.x, box.y, box.width, box.height);
+		struct wlr_vk_render_op *op = record_op(pass, WLR_VK_RENDER_OP_DRAW, &clip);
+		if (op == NULL) {
+			break;
+		}
+		op->pipe = pipe;
+		op->vert_pcr_data = (struct wlr_vk_vert_pcr_data){
 			.uv_off = { 0, 0 },
 			.uv_size = { 1, 1 },
 		};
-		mat3_to_mat4(matrix, vert_pcr_data.mat4);
-
-		bind_pipeline(pass, pipe->vk);
-		vkCmdPushConstants(cb, pipe->layout->vk,
-			VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(vert_pcr_data), &vert_pcr_data);
-		vkCmdPushConstants(cb, pipe->layout->vk,
-			VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(vert_pcr_data), sizeof(float) * 4,
-			linear_color);
-
-		for (int i = 0; i < clip_rects_len; i++) {
-			VkRect2D rect;
-			convert_pixman_box_to_vk_rect(&clip_rects[i], &rect);
-			vkCmdSetScissor(cb, 0, 1, &rect);
-			vkCmdDraw(cb, 4, 1, 0, 0);
-		}
+		mat3_to_mat4(matrix, op->vert_pcr_data.mat4);
+		memcpy(op->frag_pcr_data, linear_color, sizeof(linear_color));
+		op->frag_pcr_size = sizeof(linear_color);
 		break;
 	case WLR_RENDER_BLEND_MODE_NONE:;
-		VkClearAttachment clear_att = {
+		struct wlr_vk_render_op *clear_op =
+			record_op(pass, WLR_VK_RENDER_OP_CLEAR, &clip);
+		if (clear_op == NULL) {
+			break;
+		}
+		clear_op->clear_att = (VkClearAttachment){
 			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
 			.colorAttachment = 0,
 			.clearValue.color.float32 = {
@@ -521,19 +680,20 @@ static void render_pass_add_rect(struct wlr_render_pass *wlr_pass,
 				linear_color[3],
 			},
 		};
-		VkClearRect clear_rect = {
+		clear_op->clear_rect = (VkClearRect){
 			.rect = {
 				.offset = { box.x, box.y },
 				.extent = { box.width, box.height },
 			},
 			.layerCount = 1,
 		};
-		for (int i = 0; i < clip_rects_len; i++) {
-			VkRect2D rect;
-			convert_pixman_box_to_vk_rect(&clip_rects[i], &rect);
-			vkCmdSetScissor(cb, 0, 1, &rect);
-			vkCmdClearAttachments(cb, 1, &clear_att, 1, &clear_rect);
-		}
+		// The clear rect isn't restricted by the scissor
+		clear_op->bounds = (pixman_box32_t){
+			.x1 = box.x,
+			.y1 = box.y,
+			.x2 = box.x + box.width,
+			.y2 = box.y + box.height,
+		};
 		break;
 	}
 
@@ -545,7 +705,6 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 	struct wlr_vk_render_pass *pass = get_render_pass(wlr_pass);
 	struct wlr_vk_renderer *renderer = pass->renderer;
 	struct wlr_vk_render_buffer *render_buffer = pass->render_buffer;
-	VkCommandBuffer cb = pass->command_buffer->vk;
 
 	struct wlr_vk_texture *texture = vulkan_get_texture(options->texture);
 	assert(texture->renderer == renderer);
@@ -603,6 +762,7 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 		});
 	if (!pipe) {
 		pass->failed = true;
+		pixman_region32_fini(&clip);
 		return;
 	}
 
@@ -610,28 +770,13 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 		vulkan_texture_get_or_create_view(texture, pipe->layout);
 	if (!view) {
 		pass->failed = true;
+		pixman_region32_fini(&clip);
 		return;
 	}
 
-	bind_pipeline(pass, pipe->vk);
-
-	vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS,
-		pipe->layout->vk, 0, 1, &view->ds, 0, NULL);
-
-	vkCmdPushConstants(cb, pipe->layout->vk,
-		VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(vert_pcr_data), &vert_pcr_data);
-	vkCmdPushConstants(cb, pipe->layout->vk,
-		VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(vert_pcr_data), sizeof(float),
-		&alpha);
-
 	int clip_rects_len;
 	const pixman_box32_t *clip_rects = pixman_region32_rectangles(&clip, &clip_rects_len);
 	for (int i = 0; i < clip_rects_len; i++) {
-		VkRect2D rect;
-		convert_pixman_box_to_vk_rect(&clip_rects[i], &rect);
-		vkCmdSetScissor(cb, 0, 1, &rect);
-		vkCmdDraw(cb, 4, 1, 0, 0);
-
 		struct wlr_box clip_box = {
 			.x = clip_rects[i].x1,
 			.y = clip_rects[i].y1,
@@ -645,6 +790,19 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 		render_pass_mark_box_updated(pass, &intersection);
 	}
 
+	pixman_region32_intersect_rect(&clip, &clip,
+		dst_box.x, dst_box.y, dst_box.width, dst_box.height);
+	struct wlr_vk_render_op *op = record_op(pass, WLR_VK_RENDER_OP_DRAW, &clip);
+	pixman_region32_fini(&clip);
+	if (op == NULL) {
+		return;
+	}
+	op->pipe = pipe;
+	op->ds = view->ds;
+	op->vert_pcr_data = vert_pcr_data;
+	op->frag_pcr_data[0] = alpha;
+	op->frag_pcr_size = sizeof(alpha);
+
 	texture->last_used_cb = pass->command_buffer;
 }
 
@@ -664,9 +822,12 @@ struct wlr_vk_render_pass *vulkan_begin_render_pass(struct wlr_vk_renderer *rend
 	pass->renderer = renderer;
 
 	rect_union_init(&pass->updated_region);
+	wl_array_init(&pass->ops);
+	wl_array_init(&pass->rects);
 
 	struct wlr_vk_command_buffer *cb = vulkan_acquire_command_buffer(renderer);
 	if (cb == NULL) {
+		rect_union_finish(&pass->updated_region);
 		free(pass);
 		return NULL;
 	}
@@ -26,6 +26,7 @@
 #include "render/vulkan/shaders/output.frag.h"
 #include "types/wlr_buffer.h"
 #include "types/wlr_matrix.h"
+#include "util/time.h"
 
 // TODO:
 // - simplify stage allocation, don't track allocations but use ringbuffer-like
@@ -39,6 +40,8 @@
 
 static const VkDeviceSize min_stage_size = 1024 * 1024; // 1MB
 static const VkDeviceSize max_stage_size = 256 * min_stage_size; // 256MB
+// Staging buffers unused for this long are freed
+static const int64_t stage_idle_timeout_ms = 10 * 1000;
 static const size_t start_descriptor_pool_size = 256u;
 static bool default_debug = true;
 
@@ -177,6 +180,9 @@ static void shared_buffer_destroy(struct wlr_vk_renderer *r,
 	}
 
 	wl_array_release(&buffer->allocs);
+	if (buffer->cpu_mapping) {
+		vkUnmapMemory(r->dev->dev, buffer->memory);
+	}
 	if (buffer->buffer) {
 		vkDestroyBuffer(r->dev->dev, buffer->buffer, NULL);
 	}
@@ -301,6 +307,15 @@ struct wlr_vk_buffer_span vulkan_get_stage_span(struct wlr_vk_renderer *r,
 		goto error;
 	}
 
+	// Keep the whole buffer mapped, this avoids a map/unmap round-trip for
+	// each upload
+	res = vkMapMemory(r->dev->dev, buf->memory, 0, VK_WHOLE_SIZE, 0,
+		&buf->cpu_mapping);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkMapMemory", res);
+		goto error;
+	}
+
 	struct wlr_vk_allocation *a = wl_array_add(&buf->allocs, sizeof(*a));
 	if (a == NULL) {
 		wlr_log_errno(WLR_ERROR, "Allocation failed");
@@ -309,6 +324,7 @@ struct wlr_vk_buffer_span vulkan_get_stage_span(struct wlr_vk_renderer *r,
 
 	wlr_log(WLR_DEBUG, "Created new vk staging buffer of size %" PRIu64, bsize);
 	buf->buf_size = bsize;
+	buf->last_used_ms = get_current_time_msec();
 	wl_list_insert(&r->stage.buffers, &buf->link);
 
 	*a = (struct wlr_vk_allocation){
@@ -449,13 +465,33 @@ static void release_command_buffer_resources(struct wlr_vk_command_buffer *cb,
 		wlr_texture_destroy(&texture->wlr_texture);
 	}
 
+	int64_t now = get_current_time_msec();
+
 	struct wlr_vk_shared_buffer *buf, *buf_tmp;
 	wl_list_for_each_safe(buf, buf_tmp, &cb->stage_buffers, link) {
 		buf->allocs.size = 0;
+		buf->last_used_ms = now;
 
 		wl_list_remove(&buf->link);
 		wl_list_insert(&renderer->stage.buffers, &buf->link);
 	}
+
+	// Give back memory used during upload bursts. The largest buffer is
+	// always kept around.
+	struct wlr_vk_shared_buffer *largest = NULL;
+	wl_list_for_each(buf, &renderer->stage.buffers, link) {
+		if (largest == NULL || buf->buf_size > largest->buf_size) {
+			largest = buf;
+		}
+	}
+	wl_list_for_each_safe(buf, buf_tmp, &renderer->stage.buffers, link) {
+		if (buf != largest && buf->allocs.size == 0 &&
+				now - buf->last_used_ms > stage_idle_timeout_ms) {
+			wlr_log(WLR_DEBUG, "Destroying idle vk staging buffer of size %" PRIu64,
+				buf->buf_size);
+			shared_buffer_destroy(renderer, buf);
+		}
+	}
 }
 
 static struct wlr_vk_command_buffer *get_command_buffer(
@@ -2259,3 +2295,9 @@ uint32_t wlr_vk_renderer_get_queue_family(struct wlr_renderer *renderer) {
 	struct wlr_vk_renderer *vk_renderer = vulkan_get_renderer(renderer);
 	return vk_renderer->dev->queue_family;
 }
+
+void wlr_vk_renderer_get_stats(struct wlr_renderer *renderer,
+		struct wlr_vk_render_stats *stats) {
+	struct wlr_vk_renderer *vk_renderer = vulkan_get_renderer(renderer);
+	*stats = vk_renderer->stats;
+}
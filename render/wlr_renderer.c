@@ -41,6 +41,7 @@ void wlr_renderer_init(struct wlr_renderer *renderer,
 
 	wl_signal_init(&renderer->events.destroy);
 	wl_signal_init(&renderer->events.lost);
+	wl_list_init(&renderer->client_buffers);
 }
 
 void wlr_renderer_destroy(struct wlr_renderer *r) {
@@ -335,3 +336,12 @@ void wlr_render_timer_destroy(struct wlr_render_timer *timer) {
 	}
 	timer->impl->destroy(timer);
 }
+
+void wlr_renderer_set_client_buffer_budget(struct wlr_renderer *r,
+		size_t budget) {
+	if (wlr_renderer_is_pixman(r)) {
+		// Textures already live in system memory, evicting them saves nothing
+		return;
+	}
+	r->client_buffer_budget = budget;
+}
@@ -3,6 +3,7 @@
 #include <wlr/interfaces/wlr_buffer.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/util/log.h>
+#include "render/pixel_format.h"
 #include "types/wlr_buffer.h"
 
 static const struct wlr_buffer_impl client_buffer_impl;
@@ -22,8 +23,34 @@ static struct wlr_client_buffer *client_buffer_from_buffer(
 	return client_buffer;
 }
 
+static void client_buffer_set_texture_size(
+		struct wlr_client_buffer *client_buffer, size_t size) {
+	struct wlr_renderer *renderer = client_buffer->renderer;
+	renderer->client_buffer_usage -= client_buffer->texture_size;
+	renderer->client_buffer_usage += size;
+	client_buffer->texture_size = size;
+}
+
+static void client_buffer_free_evicted_data(
+		struct wlr_client_buffer *client_buffer) {
+	if (client_buffer->evicted_data == NULL) {
+		return;
+	}
+	if (client_buffer->renderer != NULL) {
+		client_buffer->renderer->client_buffer_evicted_usage -=
+			(size_t)client_buffer->evicted_stride * client_buffer->base.height;
+	}
+	free(client_buffer->evicted_data);
+	client_buffer->evicted_data = NULL;
+}
+
 static void client_buffer_destroy(struct wlr_buffer *buffer) {
 	struct wlr_client_buffer *client_buffer = client_buffer_from_buffer(buffer);
+	if (client_buffer->renderer != NULL) {
+		client_buffer_set_texture_size(client_buffer, 0);
+	}
+	client_buffer_free_evicted_data(client_buffer);
+	wl_list_remove(&client_buffer->link);
 	wl_list_remove(&client_buffer->source_destroy.link);
 	wl_list_remove(&client_buffer->renderer_destroy.link);
 	wlr_texture_destroy(client_buffer->texture);
@@ -61,7 +88,122 @@ static void client_buffer_handle_renderer_destroy(struct wl_listener *listener,
 		wl_container_of(listener, client_buffer, renderer_destroy);
 	wl_list_remove(&client_buffer->renderer_destroy.link);
 	wl_list_init(&client_buffer->renderer_destroy.link);
+	wl_list_remove(&client_buffer->link);
+	wl_list_init(&client_buffer->link);
+	client_buffer_free_evicted_data(client_buffer);
+	client_buffer->texture = NULL;
+	client_buffer->renderer = NULL;
+	client_buffer->texture_size = 0;
+}
+
+/**
+ * Get the amount of memory the texture created from an wl_shm buffer takes.
+ *
+ * Returns 0 for other buffer types: their texture memory is owned by the
+ * client, so they are never evicted.
+ */
+static size_t get_evictable_texture_size(struct wlr_buffer *buffer) {
+	struct wlr_shm_attributes shm;
+	if (!wlr_buffer_get_shm(buffer, &shm)) {
+		return 0;
+	}
+
+	const struct wlr_pixel_format_info *info =
+		drm_get_pixel_format_info(shm.format);
+	if (info == NULL) {
+		return (size_t)shm.stride * shm.height;
+	}
+	return (size_t)pixel_format_info_min_stride(info, shm.width) * shm.height;
+}
+
+/**
+ * Replace the texture with a copy of its contents in memory.
+ *
+ * The source buffer can't be used to re-create the texture: it has been
+ * released to the client, which may have drawn new contents since.
+ *
+ * Returns false if the copies of evicted textures have exhausted the budget.
+ */
+static bool client_buffer_evict(struct wlr_client_buffer *client_buffer) {
+	struct wlr_renderer *renderer = client_buffer->renderer;
+	struct wlr_texture *texture = client_buffer->texture;
+	assert(texture != NULL && client_buffer->evicted_data == NULL);
+
+	uint32_t format = wlr_texture_preferred_read_format(texture);
+	const struct wlr_pixel_format_info *info =
+		drm_get_pixel_format_info(format);
+	if (info == NULL) {
+		return true;
+	}
+
+	uint32_t stride = pixel_format_info_min_stride(info, texture->width);
+	size_t size = (size_t)stride * texture->height;
+	if (renderer->client_buffer_evicted_usage + size >
+			renderer->client_buffer_budget) {
+		return false;
+	}
+
+	void *data = malloc(size);
+	if (data == NULL) {
+		return true;
+	}
+	if (!wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options){
+		.data = data,
+		.format = format,
+		.stride = stride,
+	})) {
+		free(data);
+		return true;
+	}
+
+	client_buffer->evicted_data = data;
+	client_buffer->evicted_format = format;
+	client_buffer->evicted_stride = stride;
+	renderer->client_buffer_evicted_usage += size;
+
+	wlr_texture_destroy(texture);
 	client_buffer->texture = NULL;
+	client_buffer_set_texture_size(client_buffer, 0);
+
+	wl_list_remove(&client_buffer->link);
+	wl_list_init(&client_buffer->link);
+	return true;
+}
+
+/**
+ * Evict least recently used textures until the renderer is within its budget.
+ *
+ * This must not be called while a render pass is in progress, since the pass
+ * may still reference the textures.
+ */
+static void renderer_enforce_client_buffer_budget(struct wlr_renderer *renderer,
+		struct wlr_client_buffer *keep) {
+	if (renderer->client_buffer_budget == 0) {
+		return;
+	}
+
+	struct wlr_client_buffer *client_buffer, *tmp;
+	wl_list_for_each_reverse_safe(client_buffer, tmp,
+			&renderer->client_buffers, link) {
+		if (renderer->client_buffer_usage <= renderer->client_buffer_budget) {
+			break;
+		}
+		if (client_buffer == keep || client_buffer->texture_size == 0) {
+			continue;
+		}
+		if (!client_buffer_evict(client_buffer)) {
+			break;
+		}
+	}
+}
+
+static void client_buffer_touch(struct wlr_client_buffer *client_buffer) {
+	if (client_buffer->renderer == NULL) {
+		return;
+	}
+	wl_list_remove(&client_buffer->link);
+	wl_list_insert(&client_buffer->renderer->client_buffers,
+		&client_buffer->link);
 }
 
 struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
@@ -81,6 +223,12 @@ struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
 		texture->width, texture->height);
 	client_buffer->source = buffer;
 	client_buffer->texture = texture;
+	client_buffer->renderer = renderer;
+	wl_list_init(&client_buffer->link);
+	client_buffer_touch(client_buffer);
+	client_buffer_set_texture_size(client_buffer,
+		get_evictable_texture_size(buffer));
+	renderer_enforce_client_buffer_budget(renderer, client_buffer);
 
 	wl_signal_add(&buffer->events.destroy, &client_buffer->source_destroy);
 	client_buffer->source_destroy.notify = client_buffer_handle_source_destroy;
@@ -105,5 +253,39 @@ bool wlr_client_buffer_apply_damage(struct wlr_client_buffer *client_buffer,
 		return false;
 	}
 
-	return wlr_texture_update_from_buffer(client_buffer->texture, next, damage);
+	if (!wlr_texture_update_from_buffer(client_buffer->texture, next, damage)) {
+		return false;
+	}
+
+	client_buffer_set_texture_size(client_buffer,
+		get_evictable_texture_size(next));
+	client_buffer_touch(client_buffer);
+	renderer_enforce_client_buffer_budget(client_buffer->renderer,
+		client_buffer);
+	return true;
+}
+
+struct wlr_texture *wlr_client_buffer_get_texture(
+		struct wlr_client_buffer *client_buffer) {
+	client_buffer_touch(client_buffer);
+	if (client_buffer->texture != NULL || client_buffer->evicted_data == NULL) {
+		return client_buffer->texture;
+	}
+
+	struct wlr_texture *texture = wlr_texture_from_pixels(client_buffer->renderer,
+		client_buffer->evicted_format, client_buffer->evicted_stride,
+		client_buffer->base.width, client_buffer->base.height,
+		client_buffer->evicted_data);
+	if (texture == NULL) {
+		wlr_log(WLR_ERROR, "Failed to re-upload evicted client buffer");
+		return NULL;
+	}
+
+	client_buffer->texture = texture;
+	client_buffer_set_texture_size(client_buffer,
+		(size_t)client_buffer->evicted_stride * client_buffer->base.height);
+	client_buffer_free_evicted_data(client_buffer);
+	// Budget is enforced on the next upload: we may be in the middle of a
+	// render pass referencing other client buffer textures
+	return texture;
 }
@@ -0,0 +1,513 @@
+#undef _POSIX_C_SOURCE
+#define _GNU_SOURCE // for pipe2 and splice
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wlr/types/wlr_clipboard_cache.h>
+#include <wlr/types/wlr_data_device.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/util/log.h>
+#include "util/shm.h"
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+
+#define DEFAULT_MAX_SIZE (16 * 1024 * 1024)
+#define TRANSFER_CHUNK_SIZE (64 * 1024)
+
+enum clipboard_entry_state {
+	CLIPBOARD_ENTRY_EMPTY,
+	CLIPBOARD_ENTRY_FETCHING,
+	CLIPBOARD_ENTRY_READY,
+	CLIPBOARD_ENTRY_FAILED,
+};
+
+struct clipboard_source;
+
+/**
+ * The cached data for a MIME type.
+ */
+struct clipboard_entry {
+	struct clipboard_source *source;
+	struct wl_list link; // clipboard_source.entries
+	char *mime_type;
+	enum clipboard_entry_state state;
+
+	int data_fd; // -1 unless fetching or ready
+	size_t size;
+
+	int pipe_fd; // -1 unless fetching
+	struct wl_event_source *pipe_source;
+
+	struct wl_array waiting; // int, FDs to send the data to once fetched
+};
+
+struct clipboard_source {
+	struct wlr_data_source base;
+	struct wlr_clipboard_cache *cache;
+	struct wlr_data_source *origin; // may be NULL
+	struct wl_list entries; // clipboard_entry.link
+
+	struct wl_listener origin_destroy;
+};
+
+/**
+ * Sends cached data to a client. Transfers are independent from the cached
+ * source, which may be destroyed while they're in progress.
+ */
+struct clipboard_transfer {
+	struct wl_list link; // wlr_clipboard_cache.transfers
+	int data_fd, fd;
+	off_t offset;
+	size_t size;
+	struct wl_event_source *event_source;
+};
+
+static const struct wlr_data_source_impl source_impl;
+
+static void transfer_destroy(struct clipboard_transfer *transfer) {
+	if (transfer->event_source != NULL) {
+		wl_event_source_remove(transfer->event_source);
+	}
+	close(transfer->data_fd);
+	close(transfer->fd);
+	wl_list_remove(&transfer->link);
+	free(transfer);
+}
+
+/**
+ * Write as much data as possible without blocking. Returns false once the
+ * transfer is over.
+ */
+static bool transfer_write(struct clipboard_transfer *transfer) {
+	while ((size_t)transfer->offset < transfer->size) {
+		size_t len = transfer->size - transfer->offset;
+		if (len > TRANSFER_CHUNK_SIZE) {
+			len = TRANSFER_CHUNK_SIZE;
+		}
+#if defined(__linux__)
+		ssize_t n = sendfile(transfer->fd, transfer->data_fd,
+			&transfer->offset, len);
+#else
+		char buf[TRANSFER_CHUNK_SIZE];
+		ssize_t n = pread(transfer->data_fd, buf, len, transfer->offset);
+		if (n > 0) {
+			n = write(transfer->fd, buf, n);
+			if (n > 0) {
+				transfer->offset += n;
+			}
+		}
+#endif
+		if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+			return true;
+		} else if (n <= 0) {
+			wlr_log_errno(WLR_DEBUG, "Failed to send clipboard data");
+			return false;
+		}
+	}
+	return false;
+}
+
+static int transfer_handle_fd(int fd, uint32_t mask, void *data) {
+	struct clipboard_transfer *transfer = data;
+	if (!(mask & WL_EVENT_WRITABLE) || !transfer_write(transfer)) {
+		transfer_destroy(transfer);
+	}
+	return 0;
+}
+
+static void cache_send_data(struct wlr_clipboard_cache *cache,
+		struct clipboard_entry *entry, int fd) {
+	struct clipboard_transfer *transfer = calloc(1, sizeof(*transfer));
+	if (transfer == NULL) {
+		close(fd);
+		return;
+	}
+
+	transfer->data_fd = dup(entry->data_fd);
+	if (transfer->data_fd < 0) {
+		free(transfer);
+		close(fd);
+		return;
+	}
+	transfer->fd = fd;
+	transfer->size = entry->size;
+	wl_list_insert(&cache->transfers, &transfer->link);
+
+	fcntl(fd, F_SETFL, O_WRONLY | O_NONBLOCK);
+	if (!transfer_write(transfer)) {
+		transfer_destroy(transfer);
+		return;
+	}
+
+	transfer->event_source = wl_event_loop_add_fd(cache->event_loop, fd,
+		WL_EVENT_WRITABLE, transfer_handle_fd, transfer);
+	if (transfer->event_source == NULL) {
+		transfer_destroy(transfer);
+	}
+}
+
+static void entry_stop_fetch(struct clipboard_entry *entry) {
+	if (entry->pipe_source != NULL) {
+		wl_event_source_remove(entry->pipe_source);
+		entry->pipe_source = NULL;
+	}
+	if (entry->pipe_fd >= 0) {
+		close(entry->pipe_fd);
+		entry->pipe_fd = -1;
+	}
+}
+
+static void entry_finish_fetch(struct clipboard_entry *entry, bool ok) {
+	entry_stop_fetch(entry);
+
+	if (ok) {
+		entry->state = CLIPBOARD_ENTRY_READY;
+	} else {
+		entry->state = CLIPBOARD_ENTRY_FAILED;
+		close(entry->data_fd);
+		entry->data_fd = -1;
+		entry->size = 0;
+	}
+
+	struct clipboard_source *source = entry->source;
+	int *fd_ptr;
+	wl_array_for_each(fd_ptr, &entry->waiting) {
+		if (ok) {
+			cache_send_data(source->cache, entry, *fd_ptr);
+		} else if (source->origin != NULL) {
+			// Fall back to a transfer from the source client
+			wlr_data_source_send(source->origin, entry->mime_type, *fd_ptr);
+		} else {
+			close(*fd_ptr);
+		}
+	}
+	wl_array_release(&entry->waiting);
+	wl_array_init(&entry->waiting);
+}
+
+static int entry_handle_pipe(int fd, uint32_t mask, void *data) {
+	struct clipboard_entry *entry = data;
+	size_t max_size = entry->source->cache->max_size;
+
+	while (true) {
+#if defined(__linux__)
+		ssize_t n = splice(fd, NULL, entry->data_fd, NULL, TRANSFER_CHUNK_SIZE,
+			SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+#else
+		char buf[TRANSFER_CHUNK_SIZE];
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n > 0 && write(entry->data_fd, buf, n) != n) {
+			n = -1;
+		}
+#endif
+		if (n == 0) {
+			entry_finish_fetch(entry, true);
+			return 0;
+		} else if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR) {
+				return 0;
+			}
+			wlr_log_errno(WLR_DEBUG, "Failed to read clipboard data");
+			entry_finish_fetch(entry, false);
+			return 0;
+		}
+
+		entry->size += n;
+		if (entry->size > max_size) {
+			wlr_log(WLR_DEBUG, "Clipboard data for '%s' exceeds %zu bytes, "
+				"not caching it", entry->mime_type, max_size);
+			entry_finish_fetch(entry, false);
+			return 0;
+		}
+	}
+}
+
+static void entry_fetch(struct clipboard_entry *entry) {
+	struct clipboard_source *source = entry->source;
+	assert(entry->state == CLIPBOARD_ENTRY_EMPTY && source->origin != NULL);
+
+	int p[2];
+	if (pipe2(p, O_CLOEXEC | O_NONBLOCK) != 0) {
+		wlr_log_errno(WLR_ERROR, "pipe2() failed");
+		entry_finish_fetch(entry, false);
+		return;
+	}
+
+	entry->data_fd = allocate_shm_file(0);
+	if (entry->data_fd < 0) {
+		close(p[0]);
+		close(p[1]);
+		entry_finish_fetch(entry, false);
+		return;
+	}
+
+	entry->pipe_fd = p[0];
+	entry->pipe_source = wl_event_loop_add_fd(source->cache->event_loop, p[0],
+		WL_EVENT_READABLE, entry_handle_pipe, entry);
+	if (entry->pipe_source == NULL) {
+		close(p[1]);
+		entry_finish_fetch(entry, false);
+		return;
+	}
+
+	entry->state = CLIPBOARD_ENTRY_FETCHING;
+	wlr_data_source_send(source->origin, entry->mime_type, p[1]);
+}
+
+static void entry_destroy(struct clipboard_entry *entry) {
+	entry_stop_fetch(entry);
+	int *fd_ptr;
+	wl_array_for_each(fd_ptr, &entry->waiting) {
+		close(*fd_ptr);
+	}
+	wl_array_release(&entry->waiting);
+	if (entry->data_fd >= 0) {
+		close(entry->data_fd);
+	}
+	wl_list_remove(&entry->link);
+	free(entry->mime_type);
+	free(entry);
+}
+
+static struct clipboard_source *source_from_wlr_data_source(
+		struct wlr_data_source *wlr_source) {
+	assert(wlr_source->impl == &source_impl);
+	struct clipboard_source *source = wl_container_of(wlr_source, source, base);
+	return source;
+}
+
+static void source_send(struct wlr_data_source *wlr_source,
+		const char *mime_type, int32_t fd) {
+	struct clipboard_source *source = source_from_wlr_data_source(wlr_source);
+
+	struct clipboard_entry *entry = NULL, *iter;
+	wl_list_for_each(iter, &source->entries, link) {
+		if (strcmp(iter->mime_type, mime_type) == 0) {
+			entry = iter;
+			break;
+		}
+	}
+	if (entry == NULL) {
+		close(fd);
+		return;
+	}
+
+	switch (entry->state) {
+	case CLIPBOARD_ENTRY_READY:
+		cache_send_data(source->cache, entry, fd);
+		return;
+	case CLIPBOARD_ENTRY_FAILED:
+		if (source->origin != NULL) {
+			wlr_data_source_send(source->origin, mime_type, fd);
+		} else {
+			close(fd);
+		}
+		return;
+	case CLIPBOARD_ENTRY_EMPTY:
+		if (source->origin == NULL) {
+			close(fd);
+			return;
+		}
+		break;
+	case CLIPBOARD_ENTRY_FETCHING:
+		break;
+	}
+
+	int *fd_ptr = wl_array_add(&entry->waiting, sizeof(*fd_ptr));
+	if (fd_ptr == NULL) {
+		close(fd);
+		return;
+	}
+	*fd_ptr = fd;
+
+	if (entry->state == CLIPBOARD_ENTRY_EMPTY) {
+		entry_fetch(entry);
+	}
+}
+
+static void source_accept(struct wlr_data_source *wlr_source, uint32_t serial,
+		const char *mime_type) {
+	struct clipboard_source *source = source_from_wlr_data_source(wlr_source);
+	if (source->origin != NULL) {
+		wlr_data_source_accept(source->origin, serial, mime_type);
+	}
+}
+
+static void source_destroy(struct wlr_data_source *wlr_source) {
+	struct clipboard_source *source = source_from_wlr_data_source(wlr_source);
+
+	struct clipboard_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &source->entries, link) {
+		entry_destroy(entry);
+	}
+
+	if (source->origin != NULL) {
+		wl_list_remove(&source->origin_destroy.link);
+		wlr_data_source_destroy(source->origin);
+	}
+	free(source);
+}
+
+static const struct wlr_data_source_impl source_impl = {
+	.send = source_send,
+	.accept = source_accept,
+	.destroy = source_destroy,
+};
+
+static void source_handle_origin_destroy(struct wl_listener *listener,
+		void *data) {
+	struct clipboard_source *source =
+		wl_container_of(listener, source, origin_destroy);
+	wl_list_remove(&source->origin_destroy.link);
+	source->origin = NULL;
+
+	// Data which hasn't been fetched can't be retrieved anymore
+	bool has_data = false;
+	struct clipboard_entry *entry;
+	wl_list_for_each(entry, &source->entries, link) {
+		if (entry->state == CLIPBOARD_ENTRY_FETCHING ||
+				entry->state == CLIPBOARD_ENTRY_READY) {
+			has_data = true;
+		}
+	}
+	if (!has_data) {
+		wlr_data_source_destroy(&source->base);
+	}
+}
+
+static struct clipboard_source *source_create(struct wlr_clipboard_cache *cache,
+		struct wlr_data_source *origin) {
+	struct clipboard_source *source = calloc(1, sizeof(*source));
+	if (source == NULL) {
+		return NULL;
+	}
+	wlr_data_source_init(&source->base, &source_impl);
+	source->base.actions = origin->actions;
+	source->cache = cache;
+	wl_list_init(&source->entries);
+
+	char **mime_type_ptr;
+	wl_array_for_each(mime_type_ptr, &origin->mime_types) {
+		struct clipboard_entry *entry = calloc(1, sizeof(*entry));
+		if (entry == NULL) {
+			goto error;
+		}
+		entry->source = source;
+		entry->data_fd = entry->pipe_fd = -1;
+		wl_array_init(&entry->waiting);
+		wl_list_insert(source->entries.prev, &entry->link);
+
+		entry->mime_type = strdup(*mime_type_ptr);
+		char **dst = wl_array_add(&source->base.mime_types, sizeof(*dst));
+		if (entry->mime_type == NULL || dst == NULL) {
+			goto error;
+		}
+		*dst = strdup(*mime_type_ptr);
+		if (*dst == NULL) {
+			source->base.mime_types.size -= sizeof(*dst);
+			goto error;
+		}
+	}
+
+	source->origin = origin;
+	source->origin_destroy.notify = source_handle_origin_destroy;
+	wl_signal_add(&origin->events.destroy, &source->origin_destroy);
+
+	return source;
+
+error:
+	wlr_data_source_destroy(&source->base);
+	return NULL;
+}
+
+void wlr_clipboard_cache_set_selection(struct wlr_clipboard_cache *cache,
+		struct wlr_data_source *origin, uint32_t serial) {
+	if (origin == NULL) {
+		wlr_seat_set_selection(cache->seat, NULL, serial);
+		return;
+	}
+
+	struct clipboard_source *source = source_create(cache, origin);
+	if (source == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create cached clipboard source");
+		wlr_seat_set_selection(cache->seat, origin, serial);
+		return;
+	}
+
+	wlr_seat_set_selection(cache->seat, &source->base, serial);
+
+	if (cache->eager && cache->seat->selection_source == &source->base) {
+		struct clipboard_entry *entry, *tmp;
+		wl_list_for_each_safe(entry, tmp, &source->entries, link) {
+			if (source->origin == NULL) {
+				break;
+			}
+			if (entry->state == CLIPBOARD_ENTRY_EMPTY) {
+				entry_fetch(entry);
+			}
+		}
+	}
+}
+
+struct wlr_data_source *wlr_clipboard_cache_source_get_origin(
+		struct wlr_data_source *wlr_source) {
+	if (wlr_source->impl != &source_impl) {
+		return wlr_source;
+	}
+	struct clipboard_source *source = source_from_wlr_data_source(wlr_source);
+	return source->origin;
+}
+
+static void cache_handle_seat_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_clipboard_cache *cache =
+		wl_container_of(listener, cache, seat_destroy);
+	wlr_clipboard_cache_destroy(cache);
+}
+
+struct wlr_clipboard_cache *wlr_clipboard_cache_create(struct wlr_seat *seat) {
+	struct wlr_clipboard_cache *cache = calloc(1, sizeof(*cache));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	cache->seat = seat;
+	cache->max_size = DEFAULT_MAX_SIZE;
+	cache->event_loop = wl_display_get_event_loop(seat->display);
+	wl_list_init(&cache->transfers);
+	wl_signal_init(&cache->events.destroy);
+
+	cache->seat_destroy.notify = cache_handle_seat_destroy;
+	wl_signal_add(&seat->events.destroy, &cache->seat_destroy);
+
+	return cache;
+}
+
+void wlr_clipboard_cache_destroy(struct wlr_clipboard_cache *cache) {
+	if (cache == NULL) {
+		return;
+	}
+
+	wl_signal_emit_mutable(&cache->events.destroy, NULL);
+	assert(wl_list_empty(&cache->events.destroy.listener_list));
+
+	// Cached sources can't outlive the cache
+	struct wlr_data_source *selection = cache->seat->selection_source;
+	if (selection != NULL && selection->impl == &source_impl) {
+		wlr_seat_set_selection(cache->seat, NULL,
+			wl_display_next_serial(cache->seat->display));
+	}
+
+	struct clipboard_transfer *transfer, *tmp;
+	wl_list_for_each_safe(transfer, tmp, &cache->transfers, link) {
+		transfer_destroy(transfer);
+	}
+
+	wl_list_remove(&cache->seat_destroy.link);
+	free(cache);
+}
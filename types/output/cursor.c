@@ -67,6 +67,17 @@ static void output_cursor_get_box(struct wlr_output_cursor *cursor,
 	box->height = cursor->height;
 }
 
+bool output_has_software_cursors(struct wlr_output *output) {
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &output->cursors, link) {
+		if (cursor->enabled && cursor->visible && cursor->texture != NULL &&
+				output->hardware_cursor != cursor) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void wlr_output_add_software_cursors_to_render_pass(struct wlr_output *output,
 		struct wlr_render_pass *render_pass, const pixman_region32_t *damage) {
 	int width, height;
@@ -0,0 +1,215 @@
+#include <stdlib.h>
+#include <wlr/render/swapchain.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_mirror.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+#include <wlr/util/transform.h>
+
+static bool mirror_render_copy(struct wlr_output_mirror *mirror,
+		struct wlr_output_state *state, struct wlr_buffer *src_buffer) {
+	struct wlr_output *output = mirror->mirror;
+	struct wlr_output *source = mirror->source;
+
+	if (output->renderer == NULL || output->allocator == NULL) {
+		wlr_log(WLR_ERROR, "Rendering isn't initialized for mirror output '%s'",
+			output->name);
+		return false;
+	}
+
+	if (!wlr_output_configure_primary_swapchain(output, state, &output->swapchain)) {
+		return false;
+	}
+
+	struct wlr_texture *texture = wlr_texture_from_buffer(output->renderer,
+		src_buffer);
+	if (texture == NULL) {
+		wlr_log(WLR_DEBUG, "Failed to import source buffer for mirror output '%s'",
+			output->name);
+		return false;
+	}
+
+	struct wlr_buffer *buffer = wlr_swapchain_acquire(output->swapchain, NULL);
+	if (buffer == NULL) {
+		wlr_texture_destroy(texture);
+		return false;
+	}
+
+	// Fit the source contents in the mirror, in the mirror's logical
+	// coordinate space
+	int src_width, src_height, mirror_width, mirror_height;
+	wlr_output_transformed_resolution(source, &src_width, &src_height);
+	wlr_output_transformed_resolution(output, &mirror_width, &mirror_height);
+
+	struct wlr_box box = { .width = mirror_width, .height = mirror_height };
+	if (src_width > 0 && src_height > 0) {
+		double scale_x = (double)mirror_width / src_width;
+		double scale_y = (double)mirror_height / src_height;
+		double scale = scale_x < scale_y ? scale_x : scale_y;
+		box.width = src_width * scale;
+		box.height = src_height * scale;
+		box.x = (mirror_width - box.width) / 2;
+		box.y = (mirror_height - box.height) / 2;
+	}
+
+	struct wlr_box dst_box;
+	wlr_box_transform(&dst_box, &box,
+		wlr_output_transform_invert(output->transform),
+		mirror_width, mirror_height);
+
+	// The source buffer holds the contents with the source transform applied
+	enum wl_output_transform transform = wlr_output_transform_compose(
+		wlr_output_transform_invert(source->transform), output->transform);
+
+	struct wlr_render_pass *pass =
+		wlr_renderer_begin_buffer_pass(output->renderer, buffer, NULL);
+	if (pass == NULL) {
+		wlr_texture_destroy(texture);
+		wlr_buffer_unlock(buffer);
+		return false;
+	}
+
+	wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
+		.box = { .width = buffer->width, .height = buffer->height },
+		.color = { .r = 0, .g = 0, .b = 0, .a = 1 },
+	});
+	wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
+		.texture = texture,
+		.dst_box = dst_box,
+		.transform = transform,
+		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+	});
+
+	bool ok = wlr_render_pass_submit(pass);
+	wlr_texture_destroy(texture);
+	if (!ok) {
+		wlr_buffer_unlock(buffer);
+		return false;
+	}
+
+	wlr_output_state_set_buffer(state, buffer);
+	wlr_buffer_unlock(buffer);
+	return true;
+}
+
+static void mirror_commit_pending(struct wlr_output_mirror *mirror) {
+	struct wlr_output *output = mirror->mirror;
+	if (mirror->pending_buffer == NULL || !output->enabled ||
+			output->frame_pending) {
+		return;
+	}
+
+	struct wlr_buffer *src_buffer = mirror->pending_buffer;
+	mirror->pending_buffer = NULL;
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+
+	bool zero_copy = false;
+	if (mirror->source->transform == output->transform) {
+		wlr_output_state_set_buffer(&state, src_buffer);
+		zero_copy = wlr_output_test_state(output, &state);
+	}
+
+	if (!zero_copy) {
+		wlr_output_state_finish(&state);
+		wlr_output_state_init(&state);
+		if (!mirror_render_copy(mirror, &state, src_buffer)) {
+			goto out;
+		}
+	}
+
+	if (!wlr_output_commit_state(output, &state)) {
+		wlr_log(WLR_DEBUG, "Failed to commit mirror output '%s'", output->name);
+		goto out;
+	}
+	mirror->zero_copy = zero_copy;
+
+out:
+	wlr_output_state_finish(&state);
+	wlr_buffer_unlock(src_buffer);
+}
+
+static void mirror_handle_source_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_output_mirror *mirror =
+		wl_container_of(listener, mirror, source_commit);
+	const struct wlr_output_event_commit *event = data;
+
+	if (!(event->state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		return;
+	}
+
+	// Only keep the latest buffer if the mirror can't keep up
+	wlr_buffer_unlock(mirror->pending_buffer);
+	mirror->pending_buffer = wlr_buffer_lock(event->state->buffer);
+
+	mirror_commit_pending(mirror);
+}
+
+static void mirror_handle_mirror_frame(struct wl_listener *listener,
+		void *data) {
+	struct wlr_output_mirror *mirror =
+		wl_container_of(listener, mirror, mirror_frame);
+	mirror_commit_pending(mirror);
+}
+
+static void mirror_handle_source_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_output_mirror *mirror =
+		wl_container_of(listener, mirror, source_destroy);
+	wlr_output_mirror_destroy(mirror);
+}
+
+static void mirror_handle_mirror_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_output_mirror *mirror =
+		wl_container_of(listener, mirror, mirror_destroy);
+	wlr_output_mirror_destroy(mirror);
+}
+
+struct wlr_output_mirror *wlr_output_mirror_create(struct wlr_output *source,
+		struct wlr_output *output) {
+	if (source == output) {
+		wlr_log(WLR_ERROR, "Cannot mirror an output on itself");
+		return NULL;
+	}
+
+	struct wlr_output_mirror *mirror = calloc(1, sizeof(*mirror));
+	if (mirror == NULL) {
+		return NULL;
+	}
+
+	mirror->source = source;
+	mirror->mirror = output;
+
+	wl_signal_init(&mirror->events.destroy);
+
+	mirror->source_commit.notify = mirror_handle_source_commit;
+	wl_signal_add(&source->events.commit, &mirror->source_commit);
+	mirror->source_destroy.notify = mirror_handle_source_destroy;
+	wl_signal_add(&source->events.destroy, &mirror->source_destroy);
+	mirror->mirror_frame.notify = mirror_handle_mirror_frame;
+	wl_signal_add(&output->events.frame, &mirror->mirror_frame);
+	mirror->mirror_destroy.notify = mirror_handle_mirror_destroy;
+	wl_signal_add(&output->events.destroy, &mirror->mirror_destroy);
+
+	return mirror;
+}
+
+void wlr_output_mirror_destroy(struct wlr_output_mirror *mirror) {
+	if (mirror == NULL) {
+		return;
+	}
+
+	wl_signal_emit_mutable(&mirror->events.destroy, NULL);
+
+	wlr_buffer_unlock(mirror->pending_buffer);
+	wl_list_remove(&mirror->source_commit.link);
+	wl_list_remove(&mirror->source_destroy.link);
+	wl_list_remove(&mirror->mirror_frame.link);
+	wl_list_remove(&mirror->mirror_destroy.link);
+	free(mirror);
+}
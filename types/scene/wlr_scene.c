@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wlr/backend.h>
@@ -671,6 +672,7 @@ struct wlr_scene_buffer *wlr_scene_buffer_create(struct wlr_scene_tree *parent,
 	wl_signal_init(&scene_buffer->events.output_leave);
 	wl_signal_init(&scene_buffer->events.output_sample);
 	wl_signal_init(&scene_buffer->events.frame_done);
+	wl_signal_init(&scene_buffer->events.occlusion_update);
 	pixman_region32_init(&scene_buffer->opaque_region);
 	wl_list_init(&scene_buffer->buffer_release.link);
 	wl_list_init(&scene_buffer->renderer_destroy.link);
@@ -903,7 +905,7 @@ static struct wlr_texture *scene_buffer_get_texture(
 	struct wlr_client_buffer *client_buffer =
 		wlr_client_buffer_get(scene_buffer->buffer);
 	if (client_buffer != NULL) {
-		return client_buffer->texture;
+		return wlr_client_buffer_get_texture(client_buffer);
 	}
 
 	struct wlr_texture *texture =
@@ -1267,6 +1269,12 @@ void wlr_scene_set_linux_dmabuf_v1(struct wlr_scene *scene,
 	wl_signal_add(&linux_dmabuf_v1->events.destroy, &scene->linux_dmabuf_v1_destroy);
 }
 
+void wlr_scene_set_occluded_frame_interval(struct wlr_scene *scene,
+		int interval_ms) {
+	assert(interval_ms >= 0);
+	scene->occluded_frame_interval_ms = interval_ms;
+}
+
 static void scene_output_handle_destroy(struct wlr_addon *addon) {
 	struct wlr_scene_output *scene_output =
 		wl_container_of(addon, scene_output, addon);
@@ -1693,8 +1701,50 @@ out:
 	return ok;
 }
 
-bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
-		struct wlr_output_state *state, const struct wlr_scene_output_state_options *options) {
+static void scene_output_init_render_data(struct wlr_scene_output *scene_output,
+		const struct wlr_output_state *state, struct render_data *render_data,
+		int *resolution_width, int *resolution_height) {
+	struct wlr_output *output = scene_output->output;
+
+	*render_data = (struct render_data){
+		.transform = output->transform,
+		.scale = output->scale,
+		.logical = { .x = scene_output->x, .y = scene_output->y },
+		.output = scene_output,
+	};
+
+	output_pending_resolution(output, state,
+		resolution_width, resolution_height);
+
+	if (state->committed & WLR_OUTPUT_STATE_TRANSFORM) {
+		render_data->transform = state->transform;
+	}
+	if (state->committed & WLR_OUTPUT_STATE_SCALE) {
+		render_data->scale = state->scale;
+	}
+
+	render_data->trans_width = *resolution_width;
+	render_data->trans_height = *resolution_height;
+	wlr_output_transform_coords(render_data->transform,
+		&render_data->trans_width, &render_data->trans_height);
+
+	render_data->logical.width = render_data->trans_width / render_data->scale;
+	render_data->logical.height = render_data->trans_height / render_data->scale;
+}
+
+static void scene_output_damage_whole_on_change(
+		struct wlr_scene_output *scene_output, const struct render_data *render_data) {
+	struct wlr_output *output = scene_output->output;
+	if (render_data->transform != output->transform ||
+			render_data->scale != output->scale) {
+		wlr_damage_ring_add_whole(&scene_output->damage_ring);
+	}
+}
+
+static bool scene_output_build_state(struct wlr_scene_output *scene_output,
+		struct wlr_output_state *state,
+		const struct wlr_scene_output_state_options *options,
+		const struct wl_array *candidates) {
 	struct wlr_scene_output_state_options default_options = {0};
 	if (!options) {
 		options = &default_options;
@@ -1716,40 +1766,11 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 	enum wlr_scene_debug_damage_option debug_damage =
 		scene_output->scene->debug_damage_option;
 
-	struct render_data render_data = {
-		.transform = output->transform,
-		.scale = output->scale,
-		.logical = { .x = scene_output->x, .y = scene_output->y },
-		.output = scene_output,
-	};
-
+	struct render_data render_data;
 	int resolution_width, resolution_height;
-	output_pending_resolution(output, state,
+	scene_output_init_render_data(scene_output, state, &render_data,
 		&resolution_width, &resolution_height);
-
-	if (state->committed & WLR_OUTPUT_STATE_TRANSFORM) {
-		if (render_data.transform != state->transform) {
-			wlr_damage_ring_add_whole(&scene_output->damage_ring);
-		}
-
-		render_data.transform = state->transform;
-	}
-
-	if (state->committed & WLR_OUTPUT_STATE_SCALE) {
-		if (render_data.scale != state->scale) {
-			wlr_damage_ring_add_whole(&scene_output->damage_ring);
-		}
-
-		render_data.scale = state->scale;
-	}
-
-	render_data.trans_width = resolution_width;
-	render_data.trans_height = resolution_height;
-	wlr_output_transform_coords(render_data.transform,
-		&render_data.trans_width, &render_data.trans_height);
-
-	render_data.logical.width = render_data.trans_width / render_data.scale;
-	render_data.logical.height = render_data.trans_height / render_data.scale;
+	scene_output_damage_whole_on_change(scene_output, &render_data);
 
 	struct render_list_constructor_data list_con = {
 		.box = render_data.logical,
@@ -1758,8 +1779,18 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 	};
 
 	list_con.render_list->size = 0;
-	scene_nodes_in_box(&scene_output->scene->tree.node, &list_con.box,
-		construct_render_list_iterator, &list_con);
+	if (candidates != NULL) {
+		// The scene has already been walked for several outputs at once, only
+		// keep the nodes relevant to this output
+		const struct render_list_entry *candidate;
+		wl_array_for_each(candidate, candidates) {
+			construct_render_list_iterator(candidate->node,
+				candidate->x, candidate->y, &list_con);
+		}
+	} else {
+		scene_nodes_in_box(&scene_output->scene->tree.node, &list_con.box,
+			construct_render_list_iterator, &list_con);
+	}
 	array_realloc(list_con.render_list, list_con.render_list->size);
 
 	struct render_list_entry *list_data = list_con.render_list->data;
@@ -1973,6 +2004,191 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 	return true;
 }
 
+bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
+		struct wlr_output_state *state, const struct wlr_scene_output_state_options *options) {
+	return scene_output_build_state(scene_output, state, options, NULL);
+}
+
+static bool scene_output_can_copy_state(
+		const struct wlr_scene_output_state_batch_entry *src,
+		const struct wlr_scene_output_state_batch_entry *dst) {
+	struct wlr_scene_output *src_output = src->scene_output;
+	struct wlr_scene_output *dst_output = dst->scene_output;
+
+	if (!(src->state->committed & WLR_OUTPUT_STATE_BUFFER) ||
+			src_output->prev_scanout) {
+		return false;
+	}
+	if ((dst->state->committed & WLR_OUTPUT_STATE_ENABLED) &&
+			!dst->state->enabled) {
+		return false;
+	}
+	if (src_output->scene->debug_damage_option != WLR_SCENE_DEBUG_DAMAGE_NONE) {
+		return false;
+	}
+	if (src_output->output->renderer != dst_output->output->renderer) {
+		return false;
+	}
+	// Software cursors are drawn on top of the scene, and differ per output
+	if (output_has_software_cursors(src_output->output) ||
+			output_has_software_cursors(dst_output->output)) {
+		return false;
+	}
+
+	struct render_data src_data, dst_data;
+	int src_width, src_height, dst_width, dst_height;
+	scene_output_init_render_data(src_output, src->state, &src_data,
+		&src_width, &src_height);
+	scene_output_init_render_data(dst_output, dst->state, &dst_data,
+		&dst_width, &dst_height);
+	return src_width == dst_width && src_height == dst_height &&
+		src_data.transform == dst_data.transform &&
+		src_data.scale == dst_data.scale &&
+		wlr_box_equal(&src_data.logical, &dst_data.logical);
+}
+
+/**
+ * Populate an output state with a copy of a buffer rendered for another
+ * output showing the same contents. Only the damaged region is copied.
+ */
+static bool scene_output_copy_state(struct wlr_scene_output *scene_output,
+		struct wlr_output_state *state, struct wlr_buffer *src_buffer) {
+	struct wlr_output *output = scene_output->output;
+
+	struct render_data render_data;
+	int resolution_width, resolution_height;
+	scene_output_init_render_data(scene_output, state, &render_data,
+		&resolution_width, &resolution_height);
+	scene_output_damage_whole_on_change(scene_output, &render_data);
+
+	output_state_apply_damage(&render_data, state);
+
+	wlr_damage_ring_set_bounds(&scene_output->damage_ring,
+		render_data.trans_width, render_data.trans_height);
+
+	if (!wlr_output_configure_primary_swapchain(output, state, &output->swapchain)) {
+		return false;
+	}
+
+	struct wlr_texture *texture = wlr_texture_from_buffer(output->renderer,
+		src_buffer);
+	if (texture == NULL) {
+		return false;
+	}
+
+	struct wlr_buffer *buffer = wlr_swapchain_acquire(output->swapchain, NULL);
+	if (buffer == NULL) {
+		wlr_texture_destroy(texture);
+		return false;
+	}
+
+	struct wlr_render_pass *render_pass =
+		wlr_renderer_begin_buffer_pass(output->renderer, buffer, NULL);
+	if (render_pass == NULL) {
+		wlr_texture_destroy(texture);
+		wlr_buffer_unlock(buffer);
+		return false;
+	}
+
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	wlr_damage_ring_rotate_buffer(&scene_output->damage_ring, buffer, &damage);
+	transform_output_damage(&damage, &render_data);
+
+	wlr_render_pass_add_texture(render_pass, &(struct wlr_render_texture_options){
+		.texture = texture,
+		.dst_box = { .width = buffer->width, .height = buffer->height },
+		.clip = &damage,
+		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+	});
+
+	pixman_region32_fini(&damage);
+
+	bool ok = wlr_render_pass_submit(render_pass);
+	wlr_texture_destroy(texture);
+	if (!ok) {
+		wlr_buffer_unlock(buffer);
+		wlr_damage_ring_add_whole(&scene_output->damage_ring);
+		return false;
+	}
+
+	wlr_output_state_set_buffer(state, buffer);
+	wlr_buffer_unlock(buffer);
+	return true;
+}
+
+bool wlr_scene_output_build_states(
+		struct wlr_scene_output_state_batch_entry *entries, size_t entries_len) {
+	if (entries_len == 0) {
+		return true;
+	}
+
+	struct wlr_scene *scene = entries[0].scene_output->scene;
+
+	// Walk the scene once for the bounding box of all outputs
+	int x1 = INT_MAX, y1 = INT_MAX, x2 = INT_MIN, y2 = INT_MIN;
+	for (size_t i = 0; i < entries_len; i++) {
+		struct wlr_scene_output_state_batch_entry *entry = &entries[i];
+		assert(entry->scene_output->scene == scene);
+		entry->built = false;
+
+		struct render_data render_data;
+		int width, height;
+		scene_output_init_render_data(entry->scene_output, entry->state,
+			&render_data, &width, &height);
+		const struct wlr_box *box = &render_data.logical;
+		if (box->x < x1) {
+			x1 = box->x;
+		}
+		if (box->y < y1) {
+			y1 = box->y;
+		}
+		if (box->x + box->width > x2) {
+			x2 = box->x + box->width;
+		}
+		if (box->y + box->height > y2) {
+			y2 = box->y + box->height;
+		}
+	}
+
+	struct wl_array candidates;
+	wl_array_init(&candidates);
+	struct render_list_constructor_data list_con = {
+		.box = { .x = x1, .y = y1, .width = x2 - x1, .height = y2 - y1 },
+		.render_list = &candidates,
+		.calculate_visibility = scene->calculate_visibility,
+	};
+	scene_nodes_in_box(&scene->tree.node, &list_con.box,
+		construct_render_list_iterator, &list_con);
+
+	bool ok = true;
+	for (size_t i = 0; i < entries_len; i++) {
+		struct wlr_scene_output_state_batch_entry *entry = &entries[i];
+
+		// Outputs showing the same contents are only rendered once
+		struct wlr_buffer *src_buffer = NULL;
+		for (size_t j = 0; j < i; j++) {
+			if (entries[j].built &&
+					scene_output_can_copy_state(&entries[j], entry)) {
+				src_buffer = entries[j].state->buffer;
+				break;
+			}
+		}
+
+		if (src_buffer != NULL) {
+			entry->built = scene_output_copy_state(entry->scene_output,
+				entry->state, src_buffer);
+		} else {
+			entry->built = scene_output_build_state(entry->scene_output,
+				entry->state, NULL, &candidates);
+		}
+		ok = ok && entry->built;
+	}
+
+	wl_array_release(&candidates);
+	return ok;
+}
+
 int64_t wlr_scene_timer_get_duration_ns(struct wlr_scene_timer *timer) {
 	int64_t pre_render = timer->pre_render_duration;
 	if (!timer->render_timer) {
@@ -1988,9 +2204,24 @@ void wlr_scene_timer_finish(struct wlr_scene_timer *timer) {
 	}
 }
 
+static void scene_buffer_update_occluded(struct wlr_scene_buffer *scene_buffer,
+		bool occluded) {
+	if (scene_buffer->occluded == occluded) {
+		return;
+	}
+
+	scene_buffer->occluded = occluded;
+	scene_buffer->occluded_frame_done_msec = 0;
+	wl_signal_emit_mutable(&scene_buffer->events.occlusion_update, NULL);
+}
+
 static void scene_node_send_frame_done(struct wlr_scene_node *node,
-		struct wlr_scene_output *scene_output, struct timespec *now) {
-	if (!node->enabled) {
+		struct wlr_scene_output *scene_output, struct timespec *now,
+		bool enabled) {
+	int interval_ms = scene_output->scene->occluded_frame_interval_ms;
+
+	enabled = enabled && node->enabled;
+	if (!enabled && interval_ms == 0) {
 		return;
 	}
 
@@ -1998,14 +2229,31 @@ static void scene_node_send_frame_done(struct wlr_scene_node *node,
 		struct wlr_scene_buffer *scene_buffer =
 			wlr_scene_buffer_from_node(node);
 
-		if (scene_buffer->primary_output == scene_output) {
+		if (enabled && scene_buffer->primary_output == scene_output) {
 			wlr_scene_buffer_send_frame_done(scene_buffer, now);
 		}
+
+		if (interval_ms == 0) {
+			return;
+		}
+
+		// The primary output of disabled nodes isn't kept up to date
+		bool occluded = !enabled || scene_buffer->primary_output == NULL;
+		scene_buffer_update_occluded(scene_buffer, occluded);
+
+		// Each output sends frame done events, make sure occluded buffers
+		// only get one per interval
+		int64_t now_msec = timespec_to_msec(now);
+		if (occluded && now_msec - scene_buffer->occluded_frame_done_msec >=
+				interval_ms) {
+			scene_buffer->occluded_frame_done_msec = now_msec;
+			wl_signal_emit_mutable(&scene_buffer->events.frame_done, now);
+		}
 	} else if (node->type == WLR_SCENE_NODE_TREE) {
 		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
 		struct wlr_scene_node *child;
 		wl_list_for_each(child, &scene_tree->children, link) {
-			scene_node_send_frame_done(child, scene_output, now);
+			scene_node_send_frame_done(child, scene_output, now, enabled);
 		}
 	}
 }
@@ -2013,7 +2261,7 @@ static void scene_node_send_frame_done(struct wlr_scene_node *node,
 void wlr_scene_output_send_frame_done(struct wlr_scene_output *scene_output,
 		struct timespec *now) {
 	scene_node_send_frame_done(&scene_output->scene->tree.node,
-		scene_output, now);
+		scene_output, now, true);
 }
 
 static void scene_output_for_each_scene_buffer(const struct wlr_box *output_box,
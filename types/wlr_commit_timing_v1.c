@@ -0,0 +1,379 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wlr/types/wlr_commit_timing_v1.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output.h>
+#include "commit-timing-v1-protocol.h"
+#include "util/time.h"
+
+#define COMMIT_TIMING_VERSION 1
+
+struct commit_timer_commit {
+	struct wl_list link; // wlr_commit_timer_v1.commits
+	uint32_t seq;
+	int64_t target_nsec;
+};
+
+static void resource_handle_destroy(struct wl_client *client,
+		struct wl_resource *resource) {
+	wl_resource_destroy(resource);
+}
+
+static const struct wp_commit_timer_v1_interface timer_impl;
+static const struct wp_commit_timing_manager_v1_interface manager_impl;
+
+// Returns NULL if the resource is inert
+static struct wlr_commit_timer_v1 *timer_from_resource(
+		struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource,
+		&wp_commit_timer_v1_interface, &timer_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+static struct wlr_commit_timing_manager_v1 *manager_from_resource(
+		struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource,
+		&wp_commit_timing_manager_v1_interface, &manager_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+/**
+ * Get the time at which a commit targeting the specified presentation time
+ * needs to be applied, so that it's latched for the first output refresh
+ * cycle presented at or after the target.
+ */
+static int64_t timer_get_release_nsec(struct wlr_commit_timer_v1 *timer,
+		int64_t target_nsec) {
+	if (timer->output == NULL || timer->refresh_nsec <= 0 ||
+			timer->last_present_nsec == 0) {
+		return target_nsec;
+	}
+
+	int64_t refresh = timer->refresh_nsec;
+	int64_t delta = target_nsec - timer->last_present_nsec;
+	if (delta <= 0) {
+		return target_nsec;
+	}
+
+	// Content must not be presented before the target
+	int64_t n = (delta + refresh - 1) / refresh;
+	int64_t predicted_nsec = timer->last_present_nsec + n * refresh;
+	// The frame presented at predicted_nsec is rendered during the previous
+	// refresh cycle
+	return predicted_nsec - refresh;
+}
+
+static void timer_release_commit(struct wlr_commit_timer_v1 *timer,
+		struct commit_timer_commit *commit) {
+	uint32_t seq = commit->seq;
+	wl_list_remove(&commit->link);
+	free(commit);
+	wlr_surface_unlock_cached(timer->surface, seq);
+}
+
+static void timer_update(struct wlr_commit_timer_v1 *timer) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t now_nsec = timespec_to_nsec(&now);
+
+	// Commits are applied in order, so only the oldest one can be released
+	while (!wl_list_empty(&timer->commits)) {
+		struct commit_timer_commit *commit =
+			wl_container_of(timer->commits.next, commit, link);
+		int64_t release_nsec = timer_get_release_nsec(timer, commit->target_nsec);
+		if (release_nsec > now_nsec) {
+			int64_t delay_ms = (release_nsec - now_nsec + 999999) / 1000000;
+			if (delay_ms > INT_MAX) {
+				delay_ms = INT_MAX;
+			}
+			wl_event_source_timer_update(timer->timer, delay_ms);
+			return;
+		}
+		timer_release_commit(timer, commit);
+	}
+
+	wl_event_source_timer_update(timer->timer, 0);
+}
+
+static void timer_release_all(struct wlr_commit_timer_v1 *timer) {
+	while (!wl_list_empty(&timer->commits)) {
+		struct commit_timer_commit *commit =
+			wl_container_of(timer->commits.next, commit, link);
+		timer_release_commit(timer, commit);
+	}
+}
+
+static int timer_handle_timeout(void *data) {
+	struct wlr_commit_timer_v1 *timer = data;
+	timer_update(timer);
+	return 0;
+}
+
+static void timer_handle_set_timestamp(struct wl_client *client,
+		struct wl_resource *resource, uint32_t tv_sec_hi, uint32_t tv_sec_lo,
+		uint32_t tv_nsec) {
+	struct wlr_commit_timer_v1 *timer = timer_from_resource(resource);
+	if (timer == NULL) {
+		wl_resource_post_error(resource,
+			WP_COMMIT_TIMER_V1_ERROR_SURFACE_DESTROYED,
+			"The surface has been destroyed");
+		return;
+	}
+
+	if (tv_nsec >= 1000000000) {
+		wl_resource_post_error(resource,
+			WP_COMMIT_TIMER_V1_ERROR_INVALID_TIMESTAMP,
+			"Invalid timestamp nanoseconds (%"PRIu32")", tv_nsec);
+		return;
+	}
+	uint64_t tv_sec = ((uint64_t)tv_sec_hi << 32) | tv_sec_lo;
+	// The timestamp must fit in int64_t nanoseconds
+	if (tv_sec >= INT64_MAX / 1000000000 - 1) {
+		wl_resource_post_error(resource,
+			WP_COMMIT_TIMER_V1_ERROR_INVALID_TIMESTAMP,
+			"Invalid timestamp seconds (%"PRIu64")", tv_sec);
+		return;
+	}
+	if (timer->has_pending_timestamp) {
+		wl_resource_post_error(resource,
+			WP_COMMIT_TIMER_V1_ERROR_TIMESTAMP_EXISTS,
+			"A timestamp has already been set for this commit");
+		return;
+	}
+
+	timer->has_pending_timestamp = true;
+	timer->pending_timestamp = (struct timespec){
+		.tv_sec = tv_sec,
+		.tv_nsec = tv_nsec,
+	};
+}
+
+static const struct wp_commit_timer_v1_interface timer_impl = {
+	.destroy = resource_handle_destroy,
+	.set_timestamp = timer_handle_set_timestamp,
+};
+
+static void timer_handle_surface_client_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_commit_timer_v1 *timer =
+		wl_container_of(listener, timer, surface_client_commit);
+	if (!timer->has_pending_timestamp) {
+		return;
+	}
+	timer->has_pending_timestamp = false;
+
+	struct commit_timer_commit *commit = calloc(1, sizeof(*commit));
+	if (commit == NULL) {
+		wl_resource_post_no_memory(timer->resource);
+		return;
+	}
+	commit->target_nsec = timespec_to_nsec(&timer->pending_timestamp);
+	commit->seq = wlr_surface_lock_pending(timer->surface);
+	wl_list_insert(timer->commits.prev, &commit->link);
+
+	// Evaluate the commit once it has been cached
+	wl_event_source_timer_update(timer->timer, 1);
+}
+
+static void timer_handle_output_present(struct wl_listener *listener,
+		void *data) {
+	struct wlr_commit_timer_v1 *timer =
+		wl_container_of(listener, timer, output_present);
+	const struct wlr_output_event_present *event = data;
+	if (!event->presented || event->when == NULL) {
+		return;
+	}
+
+	timer->last_present_nsec = timespec_to_nsec(event->when);
+	timer->refresh_nsec = event->refresh;
+	timer_update(timer);
+}
+
+static void timer_handle_output_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_commit_timer_v1 *timer =
+		wl_container_of(listener, timer, output_destroy);
+	wlr_commit_timer_v1_set_output(timer, NULL);
+}
+
+static void timer_destroy(struct wlr_commit_timer_v1 *timer) {
+	if (timer == NULL) {
+		return;
+	}
+
+	wl_signal_emit_mutable(&timer->events.destroy, NULL);
+	assert(wl_list_empty(&timer->events.destroy.listener_list));
+
+	struct commit_timer_commit *commit, *tmp;
+	wl_list_for_each_safe(commit, tmp, &timer->commits, link) {
+		wl_list_remove(&commit->link);
+		free(commit);
+	}
+
+	wlr_addon_finish(&timer->addon);
+	wl_event_source_remove(timer->timer);
+	wl_list_remove(&timer->surface_client_commit.link);
+	wl_list_remove(&timer->output_present.link);
+	wl_list_remove(&timer->output_destroy.link);
+	wl_resource_set_user_data(timer->resource, NULL);
+	free(timer);
+}
+
+static void surface_addon_destroy(struct wlr_addon *addon) {
+	struct wlr_commit_timer_v1 *timer = wl_container_of(addon, timer, addon);
+	timer_destroy(timer);
+}
+
+static const struct wlr_addon_interface surface_addon_impl = {
+	.name = "wp_commit_timer_v1",
+	.destroy = surface_addon_destroy,
+};
+
+static void timer_handle_resource_destroy(struct wl_resource *resource) {
+	struct wlr_commit_timer_v1 *timer = timer_from_resource(resource);
+	if (timer == NULL) {
+		return;
+	}
+	// Don't leave commits locked without a way to release them
+	timer_release_all(timer);
+	timer_destroy(timer);
+}
+
+static void manager_handle_get_timer(struct wl_client *client,
+		struct wl_resource *manager_resource, uint32_t id,
+		struct wl_resource *surface_resource) {
+	struct wlr_commit_timing_manager_v1 *manager =
+		manager_from_resource(manager_resource);
+	struct wlr_surface *surface = wlr_surface_from_resource(surface_resource);
+
+	if (wlr_addon_find(&surface->addons, manager, &surface_addon_impl) != NULL) {
+		wl_resource_post_error(manager_resource,
+			WP_COMMIT_TIMING_MANAGER_V1_ERROR_COMMIT_TIMER_EXISTS,
+			"wp_commit_timer_v1 already exists for this surface");
+		return;
+	}
+
+	struct wlr_commit_timer_v1 *timer = calloc(1, sizeof(*timer));
+	if (timer == NULL) {
+		wl_resource_post_no_memory(manager_resource);
+		return;
+	}
+
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(wl_client_get_display(client));
+	timer->timer = wl_event_loop_add_timer(loop, timer_handle_timeout, timer);
+	if (timer->timer == NULL) {
+		free(timer);
+		wl_resource_post_no_memory(manager_resource);
+		return;
+	}
+
+	uint32_t version = wl_resource_get_version(manager_resource);
+	timer->resource = wl_resource_create(client,
+		&wp_commit_timer_v1_interface, version, id);
+	if (timer->resource == NULL) {
+		wl_event_source_remove(timer->timer);
+		free(timer);
+		wl_resource_post_no_memory(manager_resource);
+		return;
+	}
+	wl_resource_set_implementation(timer->resource, &timer_impl, timer,
+		timer_handle_resource_destroy);
+
+	timer->surface = surface;
+	wl_list_init(&timer->commits);
+	wl_signal_init(&timer->events.destroy);
+
+	timer->surface_client_commit.notify = timer_handle_surface_client_commit;
+	wl_signal_add(&surface->events.client_commit, &timer->surface_client_commit);
+	wl_list_init(&timer->output_present.link);
+	wl_list_init(&timer->output_destroy.link);
+
+	wlr_addon_init(&timer->addon, &surface->addons, manager, &surface_addon_impl);
+
+	wl_signal_emit_mutable(&manager->events.new_timer, timer);
+}
+
+static const struct wp_commit_timing_manager_v1_interface manager_impl = {
+	.destroy = resource_handle_destroy,
+	.get_timer = manager_handle_get_timer,
+};
+
+static void manager_bind(struct wl_client *client, void *data,
+		uint32_t version, uint32_t id) {
+	struct wlr_commit_timing_manager_v1 *manager = data;
+
+	struct wl_resource *resource = wl_resource_create(client,
+		&wp_commit_timing_manager_v1_interface, version, id);
+	if (resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &manager_impl, manager, NULL);
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_commit_timing_manager_v1 *manager =
+		wl_container_of(listener, manager, display_destroy);
+
+	wl_signal_emit_mutable(&manager->events.destroy, NULL);
+	assert(wl_list_empty(&manager->events.new_timer.listener_list));
+	assert(wl_list_empty(&manager->events.destroy.listener_list));
+
+	wl_global_destroy(manager->global);
+	wl_list_remove(&manager->display_destroy.link);
+	free(manager);
+}
+
+struct wlr_commit_timing_manager_v1 *wlr_commit_timing_manager_v1_create(
+		struct wl_display *display, uint32_t version) {
+	assert(version <= COMMIT_TIMING_VERSION);
+
+	struct wlr_commit_timing_manager_v1 *manager = calloc(1, sizeof(*manager));
+	if (manager == NULL) {
+		return NULL;
+	}
+
+	manager->global = wl_global_create(display,
+		&wp_commit_timing_manager_v1_interface, version, manager, manager_bind);
+	if (manager->global == NULL) {
+		free(manager);
+		return NULL;
+	}
+
+	wl_signal_init(&manager->events.new_timer);
+	wl_signal_init(&manager->events.destroy);
+
+	manager->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &manager->display_destroy);
+
+	return manager;
+}
+
+void wlr_commit_timer_v1_set_output(struct wlr_commit_timer_v1 *timer,
+		struct wlr_output *output) {
+	if (timer->output == output) {
+		return;
+	}
+
+	wl_list_remove(&timer->output_present.link);
+	wl_list_remove(&timer->output_destroy.link);
+	wl_list_init(&timer->output_present.link);
+	wl_list_init(&timer->output_destroy.link);
+
+	timer->output = output;
+	timer->last_present_nsec = 0;
+	timer->refresh_nsec = 0;
+
+	if (output != NULL) {
+		timer->output_present.notify = timer_handle_output_present;
+		wl_signal_add(&output->events.present, &timer->output_present);
+		timer->output_destroy.notify = timer_handle_output_destroy;
+		wl_signal_add(&output->events.destroy, &timer->output_destroy);
+	}
+
+	timer_update(timer);
+}
@@ -1,6 +1,9 @@
 #include <assert.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/render/interface.h>
 #include <wlr/types/wlr_buffer.h>
@@ -10,6 +13,8 @@
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
 #include <wlr/util/transform.h>
+#include "render/dmabuf.h"
+#include "render/pixel_format.h"
 #include "types/wlr_buffer.h"
 #include "types/wlr_region.h"
 #include "types/wlr_subcompositor.h"
@@ -18,6 +23,10 @@
 
 #define COMPOSITOR_VERSION 6
 #define CALLBACK_VERSION 1
+// Size of the tiles compared by damage refinement, in buffer pixels
+#define DAMAGE_REFINE_TILE_SIZE 32
+// Maximum number of unused cached states kept per surface
+#define CACHED_POOL_MAX_LEN 4
 
 static int min(int fst, int snd) {
 	if (fst < snd) {
@@ -284,6 +293,118 @@ static void surface_update_damage(pixman_region32_t *buffer_damage,
 	pixman_region32_fini(&surface_damage);
 }
 
+static uint64_t hash_bytes(uint64_t hash, const unsigned char *data,
+		size_t len) {
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, &data[i], sizeof(word));
+		hash = (hash ^ word) * 0x9E3779B97F4A7C15;
+		hash ^= hash >> 32;
+	}
+	for (; i < len; i++) {
+		hash = (hash ^ data[i]) * 0x100000001B3;
+	}
+	return hash;
+}
+
+static void surface_reset_damage_refine(struct wlr_surface *surface) {
+	free(surface->damage_refine.tile_hashes);
+	surface->damage_refine.tile_hashes = NULL;
+}
+
+/**
+ * Reduce the buffer damage to the tiles whose contents have changed since the
+ * previous buffer. Tiles outside of the damage submitted by the client are
+ * assumed to be unchanged.
+ */
+static void surface_refine_damage(struct wlr_surface *surface) {
+	struct wlr_buffer *buffer = surface->current.buffer;
+	if (buffer == NULL) {
+		surface_reset_damage_refine(surface);
+		return;
+	}
+
+	void *data;
+	uint32_t format;
+	size_t stride;
+	if (!wlr_buffer_begin_data_ptr_access(buffer,
+			WLR_BUFFER_DATA_PTR_ACCESS_READ, &data, &format, &stride)) {
+		surface_reset_damage_refine(surface);
+		return;
+	}
+
+	const struct wlr_pixel_format_info *info = drm_get_pixel_format_info(format);
+	if (info == NULL || pixel_format_info_pixels_per_block(info) != 1) {
+		surface_reset_damage_refine(surface);
+		goto out;
+	}
+
+	int tiles_x = (buffer->width + DAMAGE_REFINE_TILE_SIZE - 1) / DAMAGE_REFINE_TILE_SIZE;
+	int tiles_y = (buffer->height + DAMAGE_REFINE_TILE_SIZE - 1) / DAMAGE_REFINE_TILE_SIZE;
+
+	// Without hashes for the previous buffer, all tiles are considered damaged
+	bool valid = surface->damage_refine.tile_hashes != NULL &&
+		surface->damage_refine.buffer_width == buffer->width &&
+		surface->damage_refine.buffer_height == buffer->height &&
+		surface->damage_refine.format == format;
+	if (!valid) {
+		surface_reset_damage_refine(surface);
+		surface->damage_refine.tile_hashes =
+			calloc((size_t)tiles_x * tiles_y, sizeof(uint64_t));
+		if (surface->damage_refine.tile_hashes == NULL) {
+			goto out;
+		}
+		surface->damage_refine.buffer_width = buffer->width;
+		surface->damage_refine.buffer_height = buffer->height;
+		surface->damage_refine.format = format;
+	}
+
+	pixman_region32_t changed;
+	pixman_region32_init(&changed);
+
+	for (int ty = 0; ty < tiles_y; ty++) {
+		for (int tx = 0; tx < tiles_x; tx++) {
+			pixman_box32_t tile = {
+				.x1 = tx * DAMAGE_REFINE_TILE_SIZE,
+				.y1 = ty * DAMAGE_REFINE_TILE_SIZE,
+				.x2 = min((tx + 1) * DAMAGE_REFINE_TILE_SIZE, buffer->width),
+				.y2 = min((ty + 1) * DAMAGE_REFINE_TILE_SIZE, buffer->height),
+			};
+			if (valid && pixman_region32_contains_rectangle(
+					&surface->buffer_damage, &tile) == PIXMAN_REGION_OUT) {
+				continue;
+			}
+
+			const unsigned char *row = (const unsigned char *)data +
+				tile.y1 * stride + tile.x1 * info->bytes_per_block;
+			size_t len = (size_t)(tile.x2 - tile.x1) * info->bytes_per_block;
+			uint64_t hash = 0xCBF29CE484222325;
+			for (int y = tile.y1; y < tile.y2; y++) {
+				hash = hash_bytes(hash, row, len);
+				row += stride;
+			}
+
+			uint64_t *tile_hash =
+				&surface->damage_refine.tile_hashes[ty * tiles_x + tx];
+			if (*tile_hash != hash) {
+				*tile_hash = hash;
+				pixman_region32_union_rect(&changed, &changed,
+					tile.x1, tile.y1, tile.x2 - tile.x1, tile.y2 - tile.y1);
+			}
+		}
+	}
+
+	if (valid) {
+		pixman_region32_intersect(&surface->buffer_damage,
+			&surface->buffer_damage, &changed);
+	}
+	pixman_region32_fini(&changed);
+
+out:
+	wlr_buffer_end_data_ptr_access(buffer);
+}
+
 static void *surface_synced_create_state(struct wlr_surface_synced *synced) {
 	void *state = calloc(1, synced->impl->state_size);
 	if (state == NULL) {
@@ -472,11 +593,31 @@ static bool surface_state_init(struct wlr_surface_state *state,
 	struct wlr_surface *surface);
 static void surface_state_finish(struct wlr_surface_state *state);
 
+static struct wlr_surface_state *surface_take_pooled_state(
+		struct wlr_surface *surface) {
+	if (wl_list_empty(&surface->cached_pool)) {
+		return NULL;
+	}
+
+	struct wlr_surface_state *state =
+		wl_container_of(surface->cached_pool.next, state, cached_state_link);
+	wl_list_remove(&state->cached_state_link);
+	surface->cached_pool_len--;
+	return state;
+}
+
 static void surface_cache_pending(struct wlr_surface *surface) {
-	struct wlr_surface_state *cached = calloc(1, sizeof(*cached));
+	struct wlr_surface_state *cached = surface_take_pooled_state(surface);
+	if (cached != NULL) {
+		surface->cache_stats.reused++;
+		goto move;
+	}
+
+	cached = calloc(1, sizeof(*cached));
 	if (!cached) {
 		goto error;
 	}
+	surface->cache_stats.state_allocs++;
 
 	if (!surface_state_init(cached, surface)) {
 		goto error_cached;
@@ -490,8 +631,10 @@ static void surface_cache_pending(struct wlr_surface *surface) {
 			goto error_state;
 		}
 		cached_synced[synced->index] = synced_state;
+		surface->cache_stats.synced_state_allocs++;
 	}
 
+move:
 	surface_state_move(cached, &surface->pending, surface);
 
 	wl_list_insert(surface->cached.prev, &cached->cached_state_link);
@@ -532,6 +675,9 @@ static void surface_commit_state(struct wlr_surface *surface,
 
 	surface_state_move(&surface->current, next, surface);
 
+	if (invalid_buffer && surface->damage_refine.enabled) {
+		surface_refine_damage(surface);
+	}
 	if (invalid_buffer) {
 		surface_apply_damage(surface);
 	}
@@ -566,6 +712,118 @@ static void surface_commit_state(struct wlr_surface *surface,
 	surface->current.buffer = NULL;
 }
 
+/**
+ * A commit held until the fences of its DMA-BUF have signaled.
+ */
+struct surface_fence_waiter {
+	struct wlr_surface *surface;
+	struct wl_list link; // wlr_surface.fence_waiters
+	uint32_t seq;
+	int fences[WLR_DMABUF_MAX_PLANES];
+	struct wl_event_source *sources[WLR_DMABUF_MAX_PLANES];
+	int n_fences;
+};
+
+static void fence_waiter_destroy(struct surface_fence_waiter *waiter) {
+	for (int i = 0; i < waiter->n_fences; i++) {
+		if (waiter->sources[i] != NULL) {
+			wl_event_source_remove(waiter->sources[i]);
+			close(waiter->fences[i]);
+		}
+	}
+	wl_list_remove(&waiter->link);
+	free(waiter);
+}
+
+static int fence_waiter_handle_fence(int fd, uint32_t mask, void *data) {
+	struct surface_fence_waiter *waiter = data;
+
+	bool pending = false;
+	for (int i = 0; i < waiter->n_fences; i++) {
+		if (waiter->sources[i] != NULL && waiter->fences[i] == fd) {
+			wl_event_source_remove(waiter->sources[i]);
+			waiter->sources[i] = NULL;
+			close(fd);
+		}
+		pending = pending || waiter->sources[i] != NULL;
+	}
+	if (pending) {
+		return 0;
+	}
+
+	struct wlr_surface *surface = waiter->surface;
+	uint32_t seq = waiter->seq;
+	fence_waiter_destroy(waiter);
+	wlr_surface_unlock_cached(surface, seq);
+	return 0;
+}
+
+static bool fence_is_signaled(int fence) {
+	struct pollfd pollfd = { .fd = fence, .events = POLLIN };
+	return poll(&pollfd, 1, 0) != 0;
+}
+
+/**
+ * Lock the pending state until the implicit fences of its DMA-BUF signal, so
+ * that the renderer doesn't need to wait on them.
+ */
+static void surface_wait_dmabuf_fences(struct wlr_surface *surface) {
+	struct wlr_surface_state *pending = &surface->pending;
+	struct wlr_dmabuf_attributes dmabuf;
+	if (!surface->compositor->wait_dmabuf_fences ||
+			!(pending->committed & WLR_SURFACE_STATE_BUFFER) ||
+			pending->buffer == NULL ||
+			!wlr_buffer_get_dmabuf(pending->buffer, &dmabuf)) {
+		return;
+	}
+
+	struct surface_fence_waiter *waiter = calloc(1, sizeof(*waiter));
+	if (waiter == NULL) {
+		return;
+	}
+	waiter->surface = surface;
+
+	struct wl_event_loop *loop = wl_display_get_event_loop(
+		wl_client_get_display(wl_resource_get_client(surface->resource)));
+	for (int i = 0; i < dmabuf.n_planes; i++) {
+		bool dup = false;
+		for (int j = 0; j < i; j++) {
+			dup = dup || dmabuf.fd[j] == dmabuf.fd[i];
+		}
+		if (dup) {
+			continue;
+		}
+
+		// Wait for the writers, ie. the client's rendering
+		int fence = dmabuf_export_sync_file(dmabuf.fd[i], DMA_BUF_SYNC_READ);
+		if (fence < 0) {
+			continue;
+		}
+		if (fence_is_signaled(fence)) {
+			close(fence);
+			continue;
+		}
+
+		struct wl_event_source *source = wl_event_loop_add_fd(loop, fence,
+			WL_EVENT_READABLE, fence_waiter_handle_fence, waiter);
+		if (source == NULL) {
+			close(fence);
+			continue;
+		}
+		waiter->fences[waiter->n_fences] = fence;
+		waiter->sources[waiter->n_fences] = source;
+		waiter->n_fences++;
+	}
+
+	if (waiter->n_fences == 0) {
+		free(waiter);
+		return;
+	}
+
+	waiter->seq = wlr_surface_lock_pending(surface);
+	wl_list_insert(surface->fence_waiters.prev, &waiter->link);
+}
+
 static void surface_handle_commit(struct wl_client *client,
 		struct wl_resource *resource) {
 	struct wlr_surface *surface = wlr_surface_from_resource(resource);
@@ -585,6 +843,8 @@ static void surface_handle_commit(struct wl_client *client,
 		return;
 	}
 
+	surface_wait_dmabuf_fences(surface);
+
 	if (surface->pending.cached_state_locks > 0 || !wl_list_empty(&surface->cached)) {
 		surface_cache_pending(surface);
 	} else {
@@ -660,8 +920,7 @@ struct wlr_surface *wlr_surface_from_resource(struct wl_resource *resource) {
 	return wl_resource_get_user_data(resource);
 }
 
-static bool surface_state_init(struct wlr_surface_state *state,
-		struct wlr_surface *surface) {
+static void surface_state_init_fields(struct wlr_surface_state *state) {
 	*state = (struct wlr_surface_state){
 		.scale = 1,
 		.transform = WL_OUTPUT_TRANSFORM_NORMAL,
@@ -679,6 +938,11 @@ static bool surface_state_init(struct wlr_surface_state *state,
 		INT32_MIN, INT32_MIN, UINT32_MAX, UINT32_MAX);
 
 	wl_array_init(&state->synced);
+}
+
+static bool surface_state_init(struct wlr_surface_state *state,
+		struct wlr_surface *surface) {
+	surface_state_init_fields(state);
 	void *ptr = wl_array_add(&state->synced, surface->synced_len * sizeof(void *));
 	return ptr != NULL;
 }
@@ -712,6 +976,51 @@ static void surface_state_destroy_cached(struct wlr_surface_state *state,
 	free(state);
 }
 
+/**
+ * Reset a cached state which has been committed and put it in the pool of
+ * unused cached states, keeping its synced states allocated.
+ */
+static void surface_state_recycle_cached(struct wlr_surface_state *state,
+		struct wlr_surface *surface) {
+	if (surface->cached_pool_len >= CACHED_POOL_MAX_LEN) {
+		surface_state_destroy_cached(state, surface);
+		return;
+	}
+
+	void **synced_states = state->synced.data;
+	struct wlr_surface_synced *synced;
+	wl_list_for_each(synced, &surface->synced, link) {
+		void *synced_state = synced_states[synced->index];
+		if (synced->impl->finish_state) {
+			synced->impl->finish_state(synced_state);
+		}
+		memset(synced_state, 0, synced->impl->state_size);
+		if (synced->impl->init_state) {
+			synced->impl->init_state(synced_state);
+		}
+	}
+
+	// Unlink before resetting the fields, which clears the link
+	wl_list_remove(&state->cached_state_link);
+
+	struct wl_array synced_array = state->synced;
+	wl_array_init(&state->synced);
+	surface_state_finish(state);
+	surface_state_init_fields(state);
+	state->synced = synced_array;
+
+	wl_list_insert(&surface->cached_pool, &state->cached_state_link);
+	surface->cached_pool_len++;
+}
+
+static void surface_drain_cached_pool(struct wlr_surface *surface) {
+	struct wlr_surface_state *state, *tmp;
+	wl_list_for_each_safe(state, tmp, &surface->cached_pool, cached_state_link) {
+		surface_state_destroy_cached(state, surface);
+	}
+	surface->cached_pool_len = 0;
+}
+
 static void surface_output_destroy(struct wlr_surface_output *surface_output);
 static void surface_destroy_role_object(struct wlr_surface *surface);
 
@@ -731,10 +1040,16 @@ static void surface_handle_resource_destroy(struct wl_resource *resource) {
 	wlr_addon_set_finish(&surface->addons);
 	assert(wl_list_empty(&surface->synced));
 
+	struct surface_fence_waiter *waiter, *waiter_tmp;
+	wl_list_for_each_safe(waiter, waiter_tmp, &surface->fence_waiters, link) {
+		fence_waiter_destroy(waiter);
+	}
+
 	struct wlr_surface_state *cached, *cached_tmp;
 	wl_list_for_each_safe(cached, cached_tmp, &surface->cached, cached_state_link) {
 		surface_state_destroy_cached(cached, surface);
 	}
+	surface_drain_cached_pool(surface);
 
 	wl_list_remove(&surface->role_resource_destroy.link);
 
@@ -748,6 +1063,7 @@ static void surface_handle_resource_destroy(struct wl_resource *resource) {
 	if (surface->buffer != NULL) {
 		wlr_buffer_unlock(&surface->buffer->base);
 	}
+	free(surface->damage_refine.tile_hashes);
 	free(surface);
 }
 
@@ -784,6 +1100,8 @@ static struct wlr_surface *surface_create(struct wl_client *client,
 	wl_signal_init(&surface->events.new_subsurface);
 	wl_list_init(&surface->current_outputs);
 	wl_list_init(&surface->cached);
+	wl_list_init(&surface->cached_pool);
+	wl_list_init(&surface->fence_waiters);
 	pixman_region32_init(&surface->buffer_damage);
 	pixman_region32_init(&surface->opaque_region);
 	pixman_region32_init(&surface->input_region);
@@ -802,7 +1120,7 @@ struct wlr_texture *wlr_surface_get_texture(struct wlr_surface *surface) {
 	if (surface->buffer == NULL) {
 		return NULL;
 	}
-	return surface->buffer->texture;
+	return wlr_client_buffer_get_texture(surface->buffer);
 }
 
 bool wlr_surface_has_buffer(struct wlr_surface *surface) {
@@ -966,7 +1284,7 @@ void wlr_surface_unlock_cached(struct wlr_surface *surface, uint32_t seq) {
 		}
 
 		surface_commit_state(surface, next);
-		surface_state_destroy_cached(next, surface);
+		surface_state_recycle_cached(next, surface);
 	}
 }
 
@@ -1227,6 +1545,19 @@ void wlr_surface_get_effective_damage(struct wlr_surface *surface,
 	}
 }
 
+void wlr_surface_set_damage_refinement(struct wlr_surface *surface,
+		bool enabled) {
+	surface->damage_refine.enabled = enabled;
+	if (!enabled) {
+		surface_reset_damage_refine(surface);
+	}
+}
+
+void wlr_surface_get_cache_stats(struct wlr_surface *surface,
+		struct wlr_surface_cache_stats *stats) {
+	*stats = surface->cache_stats;
+}
+
 void wlr_surface_get_buffer_source_box(struct wlr_surface *surface,
 		struct wlr_fbox *box) {
 	box->x = box->y = 0;
@@ -1386,6 +1717,18 @@ void wlr_compositor_set_renderer(struct wlr_compositor *compositor,
 	}
 }
 
+bool wlr_compositor_set_wait_dmabuf_fences(struct wlr_compositor *compositor,
+		bool enabled) {
+	if (enabled && !dmabuf_check_sync_file_import_export()) {
+		wlr_log(WLR_INFO, "DMA-BUF fence export unsupported, "
+			"not waiting for fences on commit");
+		compositor->wait_dmabuf_fences = false;
+		return false;
+	}
+	compositor->wait_dmabuf_fences = enabled;
+	return true;
+}
+
 static bool surface_state_add_synced(struct wlr_surface_state *state, void *value) {
 	void **ptr = wl_array_add(&state->synced, sizeof(void *));
 	if (ptr == NULL) {
@@ -1419,6 +1762,9 @@ bool wlr_surface_synced_init(struct wlr_surface_synced *synced,
 		assert(synced != other);
 	}
 
+	// Pooled states don't have a state for the new synced object
+	surface_drain_cached_pool(surface);
+
 	memset(pending, 0, impl->state_size);
 	memset(current, 0, impl->state_size);
 	if (impl->init_state) {
@@ -1475,6 +1821,8 @@ error_init:
 void wlr_surface_synced_finish(struct wlr_surface_synced *synced) {
 	struct wlr_surface *surface = synced->surface;
 
+	surface_drain_cached_pool(surface);
+
 	bool found = false;
 	struct wlr_surface_synced *other;
 	wl_list_for_each(other, &surface->synced, link) {
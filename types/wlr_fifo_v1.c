@@ -0,0 +1,373 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <wlr/types/wlr_fifo_v1.h>
+#include <wlr/types/wlr_output.h>
+#include "fifo-v1-protocol.h"
+
+#define FIFO_VERSION 1
+
+// Number of refresh cycles after which the barrier is cleared if the output
+// hasn't latched a new buffer
+#define FIFO_BARRIER_TIMEOUT_CYCLES 2
+#define FIFO_DEFAULT_REFRESH 60000 // mHz
+
+struct fifo_commit {
+	struct wl_list link; // wlr_fifo_v1.commits
+	uint32_t seq;
+	// Value of wlr_fifo_v1.requested_barriers when this commit was made
+	uint64_t requested_barriers;
+};
+
+static void resource_handle_destroy(struct wl_client *client,
+		struct wl_resource *resource) {
+	wl_resource_destroy(resource);
+}
+
+static const struct wp_fifo_v1_interface fifo_impl;
+static const struct wp_fifo_manager_v1_interface manager_impl;
+
+// Returns NULL if the resource is inert
+static struct wlr_fifo_v1 *fifo_from_resource(struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource, &wp_fifo_v1_interface, &fifo_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+static struct wlr_fifo_manager_v1 *manager_from_resource(
+		struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource,
+		&wp_fifo_manager_v1_interface, &manager_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+/**
+ * Apply queued commits until one of them sets the barrier again, or waits on
+ * a barrier requested by a commit which hasn't been applied yet.
+ */
+static void fifo_release(struct wlr_fifo_v1 *fifo) {
+	while (!fifo->barrier && !wl_list_empty(&fifo->commits)) {
+		struct fifo_commit *commit =
+			wl_container_of(fifo->commits.next, commit, link);
+		if (fifo->applied_barriers < commit->requested_barriers) {
+			break;
+		}
+		uint32_t seq = commit->seq;
+		wl_list_remove(&commit->link);
+		free(commit);
+		wlr_surface_unlock_cached(fifo->surface, seq);
+	}
+}
+
+static void fifo_clear_barrier(struct wlr_fifo_v1 *fifo) {
+	fifo->barrier = false;
+	wl_event_source_timer_update(fifo->timer, 0);
+	fifo_release(fifo);
+}
+
+static int fifo_handle_timeout(void *data) {
+	struct wlr_fifo_v1 *fifo = data;
+	fifo_clear_barrier(fifo);
+	return 0;
+}
+
+static void fifo_handle_set_barrier(struct wl_client *client,
+		struct wl_resource *resource) {
+	struct wlr_fifo_v1 *fifo = fifo_from_resource(resource);
+	if (fifo == NULL) {
+		wl_resource_post_error(resource, WP_FIFO_V1_ERROR_SURFACE_DESTROYED,
+			"The surface has been destroyed");
+		return;
+	}
+	fifo->pending.set_barrier = true;
+}
+
+static void fifo_handle_wait_barrier(struct wl_client *client,
+		struct wl_resource *resource) {
+	struct wlr_fifo_v1 *fifo = fifo_from_resource(resource);
+	if (fifo == NULL) {
+		wl_resource_post_error(resource, WP_FIFO_V1_ERROR_SURFACE_DESTROYED,
+			"The surface has been destroyed");
+		return;
+	}
+	fifo->pending_wait_barrier = true;
+}
+
+static const struct wp_fifo_v1_interface fifo_impl = {
+	.set_barrier = fifo_handle_set_barrier,
+	.wait_barrier = fifo_handle_wait_barrier,
+	.destroy = resource_handle_destroy,
+};
+
+static void fifo_handle_surface_client_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_fifo_v1 *fifo =
+		wl_container_of(listener, fifo, surface_client_commit);
+	bool wait_barrier = fifo->pending_wait_barrier;
+	fifo->pending_wait_barrier = false;
+
+	// The barrier may have been requested by a commit which hasn't been
+	// applied yet, e.g. because it is still cached
+	uint64_t requested_barriers = fifo->requested_barriers;
+	if (fifo->pending.set_barrier) {
+		fifo->requested_barriers++;
+	}
+	if (!wait_barrier || (!fifo->barrier &&
+			fifo->applied_barriers == requested_barriers &&
+			wl_list_empty(&fifo->commits))) {
+		return;
+	}
+
+	struct fifo_commit *commit = calloc(1, sizeof(*commit));
+	if (commit == NULL) {
+		wl_resource_post_no_memory(fifo->resource);
+		return;
+	}
+	commit->seq = wlr_surface_lock_pending(fifo->surface);
+	commit->requested_barriers = requested_barriers;
+	wl_list_insert(fifo->commits.prev, &commit->link);
+}
+
+static void fifo_handle_surface_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_fifo_v1 *fifo = wl_container_of(listener, fifo, surface_commit);
+	if (!fifo->current.set_barrier) {
+		return;
+	}
+
+	fifo->applied_barriers++;
+	assert(fifo->applied_barriers <= fifo->requested_barriers);
+	fifo->barrier = true;
+
+	int timeout_ms = 1;
+	if (fifo->output != NULL && fifo->output->enabled) {
+		int refresh = fifo->output->refresh;
+		if (refresh <= 0) {
+			refresh = FIFO_DEFAULT_REFRESH;
+		}
+		timeout_ms = FIFO_BARRIER_TIMEOUT_CYCLES * 1000000 / refresh;
+	}
+	// Without an enabled output, nothing will latch the contents: clear the
+	// barrier on the next loop iteration, since cached commits can't be
+	// released from within the surface commit handler
+	wl_event_source_timer_update(fifo->timer, timeout_ms > 0 ? timeout_ms : 1);
+}
+
+static void fifo_handle_output_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_fifo_v1 *fifo = wl_container_of(listener, fifo, output_commit);
+	const struct wlr_output_event_commit *event = data;
+	if (fifo->barrier && (event->state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		fifo_clear_barrier(fifo);
+	}
+}
+
+static void fifo_handle_output_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_fifo_v1 *fifo = wl_container_of(listener, fifo, output_destroy);
+	wlr_fifo_v1_set_output(fifo, NULL);
+}
+
+static void fifo_destroy(struct wlr_fifo_v1 *fifo) {
+	if (fifo == NULL) {
+		return;
+	}
+
+	wl_signal_emit_mutable(&fifo->events.destroy, NULL);
+	assert(wl_list_empty(&fifo->events.destroy.listener_list));
+
+	struct fifo_commit *commit, *tmp;
+	wl_list_for_each_safe(commit, tmp, &fifo->commits, link) {
+		wl_list_remove(&commit->link);
+		free(commit);
+	}
+
+	wlr_addon_finish(&fifo->addon);
+	wlr_surface_synced_finish(&fifo->synced);
+	wl_event_source_remove(fifo->timer);
+	wl_list_remove(&fifo->surface_client_commit.link);
+	wl_list_remove(&fifo->surface_commit.link);
+	wl_list_remove(&fifo->output_commit.link);
+	wl_list_remove(&fifo->output_destroy.link);
+	wl_resource_set_user_data(fifo->resource, NULL);
+	free(fifo);
+}
+
+static void surface_addon_destroy(struct wlr_addon *addon) {
+	struct wlr_fifo_v1 *fifo = wl_container_of(addon, fifo, addon);
+	fifo_destroy(fifo);
+}
+
+static const struct wlr_addon_interface surface_addon_impl = {
+	.name = "wp_fifo_v1",
+	.destroy = surface_addon_destroy,
+};
+
+static void surface_synced_move_state(void *_dst, void *_src) {
+	struct wlr_fifo_v1_state *dst = _dst, *src = _src;
+	*dst = *src;
+	// The barrier is only set by the commit which requested it
+	src->set_barrier = false;
+}
+
+static const struct wlr_surface_synced_impl surface_synced_impl = {
+	.state_size = sizeof(struct wlr_fifo_v1_state),
+	.move_state = surface_synced_move_state,
+};
+
+static void fifo_handle_resource_destroy(struct wl_resource *resource) {
+	struct wlr_fifo_v1 *fifo = fifo_from_resource(resource);
+	if (fifo == NULL) {
+		return;
+	}
+	// Don't leave commits locked without a way to release them. Stop tracking
+	// barriers first, so that the applied commits don't set them again.
+	wl_list_remove(&fifo->surface_commit.link);
+	wl_list_init(&fifo->surface_commit.link);
+	fifo->applied_barriers = fifo->requested_barriers;
+	fifo_clear_barrier(fifo);
+	fifo_destroy(fifo);
+}
+
+static void manager_handle_get_fifo(struct wl_client *client,
+		struct wl_resource *manager_resource, uint32_t id,
+		struct wl_resource *surface_resource) {
+	struct wlr_fifo_manager_v1 *manager = manager_from_resource(manager_resource);
+	struct wlr_surface *surface = wlr_surface_from_resource(surface_resource);
+
+	if (wlr_addon_find(&surface->addons, manager, &surface_addon_impl) != NULL) {
+		wl_resource_post_error(manager_resource,
+			WP_FIFO_MANAGER_V1_ERROR_ALREADY_EXISTS,
+			"wp_fifo_v1 already exists for this surface");
+		return;
+	}
+
+	struct wlr_fifo_v1 *fifo = calloc(1, sizeof(*fifo));
+	if (fifo == NULL) {
+		wl_resource_post_no_memory(manager_resource);
+		return;
+	}
+
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(wl_client_get_display(client));
+	fifo->timer = wl_event_loop_add_timer(loop, fifo_handle_timeout, fifo);
+	if (fifo->timer == NULL) {
+		free(fifo);
+		wl_resource_post_no_memory(manager_resource);
+		return;
+	}
+
+	if (!wlr_surface_synced_init(&fifo->synced, surface,
+			&surface_synced_impl, &fifo->pending, &fifo->current)) {
+		wl_event_source_remove(fifo->timer);
+		free(fifo);
+		wl_resource_post_no_memory(manager_resource);
+		return;
+	}
+
+	uint32_t version = wl_resource_get_version(manager_resource);
+	fifo->resource = wl_resource_create(client,
+		&wp_fifo_v1_interface, version, id);
+	if (fifo->resource == NULL) {
+		wlr_surface_synced_finish(&fifo->synced);
+		wl_event_source_remove(fifo->timer);
+		free(fifo);
+		wl_resource_post_no_memory(manager_resource);
+		return;
+	}
+	wl_resource_set_implementation(fifo->resource, &fifo_impl, fifo,
+		fifo_handle_resource_destroy);
+
+	fifo->surface = surface;
+	wl_list_init(&fifo->commits);
+	wl_signal_init(&fifo->events.destroy);
+
+	fifo->surface_client_commit.notify = fifo_handle_surface_client_commit;
+	wl_signal_add(&surface->events.client_commit, &fifo->surface_client_commit);
+	fifo->surface_commit.notify = fifo_handle_surface_commit;
+	wl_signal_add(&surface->events.commit, &fifo->surface_commit);
+	wl_list_init(&fifo->output_commit.link);
+	wl_list_init(&fifo->output_destroy.link);
+
+	wlr_addon_init(&fifo->addon, &surface->addons, manager, &surface_addon_impl);
+
+	wl_signal_emit_mutable(&manager->events.new_fifo, fifo);
+}
+
+static const struct wp_fifo_manager_v1_interface manager_impl = {
+	.destroy = resource_handle_destroy,
+	.get_fifo = manager_handle_get_fifo,
+};
+
+static void manager_bind(struct wl_client *client, void *data,
+		uint32_t version, uint32_t id) {
+	struct wlr_fifo_manager_v1 *manager = data;
+
+	struct wl_resource *resource = wl_resource_create(client,
+		&wp_fifo_manager_v1_interface, version, id);
+	if (resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &manager_impl, manager, NULL);
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_fifo_manager_v1 *manager =
+		wl_container_of(listener, manager, display_destroy);
+
+	wl_signal_emit_mutable(&manager->events.destroy, NULL);
+	assert(wl_list_empty(&manager->events.new_fifo.listener_list));
+	assert(wl_list_empty(&manager->events.destroy.listener_list));
+
+	wl_global_destroy(manager->global);
+	wl_list_remove(&manager->display_destroy.link);
+	free(manager);
+}
+
+struct wlr_fifo_manager_v1 *wlr_fifo_manager_v1_create(
+		struct wl_display *display, uint32_t version) {
+	assert(version <= FIFO_VERSION);
+
+	struct wlr_fifo_manager_v1 *manager = calloc(1, sizeof(*manager));
+	if (manager == NULL) {
+		return NULL;
+	}
+
+	manager->global = wl_global_create(display,
+		&wp_fifo_manager_v1_interface, version, manager, manager_bind);
+	if (manager->global == NULL) {
+		free(manager);
+		return NULL;
+	}
+
+	wl_signal_init(&manager->events.new_fifo);
+	wl_signal_init(&manager->events.destroy);
+
+	manager->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &manager->display_destroy);
+
+	return manager;
+}
+
+void wlr_fifo_v1_set_output(struct wlr_fifo_v1 *fifo,
+		struct wlr_output *output) {
+	if (fifo->output == output) {
+		return;
+	}
+
+	wl_list_remove(&fifo->output_commit.link);
+	wl_list_remove(&fifo->output_destroy.link);
+	wl_list_init(&fifo->output_commit.link);
+	wl_list_init(&fifo->output_destroy.link);
+
+	fifo->output = output;
+
+	if (output != NULL) {
+		fifo->output_commit.notify = fifo_handle_output_commit;
+		wl_signal_add(&output->events.commit, &fifo->output_commit);
+		fifo->output_destroy.notify = fifo_handle_output_destroy;
+		wl_signal_add(&output->events.destroy, &fifo->output_destroy);
+	} else {
+		// Hidden surfaces must not be blocked
+		fifo_clear_barrier(fifo);
+	}
+}
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/types/wlr_input_latency.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+static size_t latency_bucket(uint64_t latency_usec) {
+	size_t i = 0;
+	while (latency_usec > 1 && i < WLR_INPUT_LATENCY_BUCKETS - 1) {
+		latency_usec >>= 1;
+		i++;
+	}
+	return i;
+}
+
+static void histogram_add(struct wlr_input_latency_histogram *histogram,
+		uint64_t latency_usec) {
+	histogram->buckets[latency_bucket(latency_usec)]++;
+	if (histogram->count == 0 || latency_usec < histogram->min_usec) {
+		histogram->min_usec = latency_usec;
+	}
+	if (latency_usec > histogram->max_usec) {
+		histogram->max_usec = latency_usec;
+	}
+	histogram->sum_usec += latency_usec;
+	histogram->count++;
+}
+
+static void tracker_handle_output_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_latency_tracker *tracker =
+		wl_container_of(listener, tracker, output_commit);
+	const struct wlr_output_event_commit *event = data;
+
+	if (!(event->state->committed & WLR_OUTPUT_STATE_BUFFER) ||
+			tracker->pending_input_usec == 0) {
+		return;
+	}
+
+	// Overwrites the oldest frame if the backend never sent its present event
+	tracker->inflight[tracker->inflight_next] = (struct wlr_input_latency_frame){
+		.commit_seq = tracker->output->commit_seq,
+		.input_usec = tracker->pending_input_usec,
+	};
+	tracker->inflight_next =
+		(tracker->inflight_next + 1) % WLR_INPUT_LATENCY_INFLIGHT_LEN;
+	tracker->pending_input_usec = 0;
+}
+
+static void tracker_handle_output_present(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_latency_tracker *tracker =
+		wl_container_of(listener, tracker, output_present);
+	const struct wlr_output_event_present *event = data;
+
+	struct wlr_input_latency_frame *frame = NULL;
+	for (size_t i = 0; i < WLR_INPUT_LATENCY_INFLIGHT_LEN; i++) {
+		if (tracker->inflight[i].input_usec != 0 &&
+				tracker->inflight[i].commit_seq == event->commit_seq) {
+			frame = &tracker->inflight[i];
+			break;
+		}
+	}
+	if (frame == NULL) {
+		return;
+	}
+
+	uint64_t input_usec = frame->input_usec;
+	frame->input_usec = 0;
+
+	if (!event->presented || event->when == NULL) {
+		// Attribute the input to the next frame instead
+		if (tracker->pending_input_usec == 0) {
+			tracker->pending_input_usec = input_usec;
+		}
+		return;
+	}
+
+	uint64_t present_usec = (uint64_t)event->when->tv_sec * 1000000 +
+		(uint64_t)event->when->tv_nsec / 1000;
+	if (present_usec < input_usec) {
+		wlr_log(WLR_DEBUG, "Input event timestamp is in the future, "
+			"ignoring latency sample");
+		return;
+	}
+
+	uint64_t latency_usec = present_usec - input_usec;
+	histogram_add(&tracker->histogram, latency_usec);
+
+	struct wlr_input_latency_sample_event sample = {
+		.tracker = tracker,
+		.commit_seq = event->commit_seq,
+		.input_usec = input_usec,
+		.present_usec = present_usec,
+		.latency_usec = latency_usec,
+	};
+	wl_signal_emit_mutable(&tracker->events.sample, &sample);
+}
+
+static void tracker_handle_output_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_latency_tracker *tracker =
+		wl_container_of(listener, tracker, output_destroy);
+	wlr_input_latency_tracker_destroy(tracker);
+}
+
+struct wlr_input_latency_tracker *wlr_input_latency_tracker_create(
+		struct wlr_output *output) {
+	struct wlr_input_latency_tracker *tracker = calloc(1, sizeof(*tracker));
+	if (tracker == NULL) {
+		return NULL;
+	}
+
+	tracker->output = output;
+
+	wl_signal_init(&tracker->events.sample);
+	wl_signal_init(&tracker->events.destroy);
+
+	tracker->output_commit.notify = tracker_handle_output_commit;
+	wl_signal_add(&output->events.commit, &tracker->output_commit);
+	tracker->output_present.notify = tracker_handle_output_present;
+	wl_signal_add(&output->events.present, &tracker->output_present);
+	tracker->output_destroy.notify = tracker_handle_output_destroy;
+	wl_signal_add(&output->events.destroy, &tracker->output_destroy);
+
+	return tracker;
+}
+
+void wlr_input_latency_tracker_destroy(struct wlr_input_latency_tracker *tracker) {
+	if (tracker == NULL) {
+		return;
+	}
+
+	wl_signal_emit_mutable(&tracker->events.destroy, NULL);
+
+	wl_list_remove(&tracker->output_commit.link);
+	wl_list_remove(&tracker->output_present.link);
+	wl_list_remove(&tracker->output_destroy.link);
+	free(tracker);
+}
+
+void wlr_input_latency_tracker_notify_input(
+		struct wlr_input_latency_tracker *tracker, uint64_t time_usec) {
+	if (time_usec > tracker->pending_input_usec) {
+		tracker->pending_input_usec = time_usec;
+	}
+}
+
+void wlr_input_latency_tracker_reset(struct wlr_input_latency_tracker *tracker) {
+	memset(&tracker->histogram, 0, sizeof(tracker->histogram));
+}
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <drm_fourcc.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/allocator.h>
@@ -15,13 +16,41 @@
 #include "render/wlr_renderer.h"
 
 #define SCREENCOPY_MANAGER_VERSION 3
-
+// Maximum number of client buffers tracked per client and output
+#define SCREENCOPY_MAX_BUFFERS 4
+// Above this number of rectangles, the damage extents are read back instead
+#define SCREENCOPY_MAX_DAMAGE_RECTS 16
+
+/**
+ * Per client and output state.
+ */
 struct screencopy_damage {
 	struct wl_list link;
 	struct wlr_output *output;
 	struct pixman_region32 damage;
+	struct wl_list buffers; // screencopy_buffer.link
+
+	// Texture for the last output buffer captured, kept until the next buffer
+	// is committed so that multiple frames of a single commit share it
+	struct wlr_buffer *texture_buffer; // locked, may be NULL
+	struct wlr_texture *texture; // may be NULL
+	struct wlr_renderer *texture_renderer; // may be NULL
+
 	struct wl_listener output_precommit;
 	struct wl_listener output_destroy;
+	struct wl_listener renderer_destroy;
+};
+
+/**
+ * A client buffer previously filled with copy_with_damage. Only the regions
+ * damaged since the last copy into it need to be read back again.
+ */
+struct screencopy_buffer {
+	struct wl_list link; // screencopy_damage.buffers
+	struct wlr_buffer *buffer;
+	struct wlr_box box; // capture box of the last successful copy, empty if none
+	struct pixman_region32 damage; // output buffer-local coordinates
+	struct wl_listener buffer_destroy;
 };
 
 static const struct zwlr_screencopy_frame_v1_interface frame_impl;
@@ -40,11 +69,8 @@ static struct screencopy_damage *screencopy_damage_find(
 	return NULL;
 }
 
-static void screencopy_damage_accumulate(struct screencopy_damage *damage,
-		const struct wlr_output_state *state) {
-	struct pixman_region32 *region = &damage->damage;
-	struct wlr_output *output = damage->output;
-
+static void damage_region_accumulate(struct pixman_region32 *region,
+		struct wlr_output *output, const struct wlr_output_state *state) {
 	if (state->committed & WLR_OUTPUT_STATE_DAMAGE) {
 		// If the compositor submitted damage, copy it over
 		pixman_region32_union(region, region, &state->damage);
@@ -58,6 +84,38 @@ static void screencopy_damage_accumulate(struct screencopy_damage *damage,
 	}
 }
 
+static void screencopy_damage_release_texture(struct screencopy_damage *damage) {
+	wlr_texture_destroy(damage->texture);
+	wlr_buffer_unlock(damage->texture_buffer);
+	damage->texture = NULL;
+	damage->texture_buffer = NULL;
+	damage->texture_renderer = NULL;
+	wl_list_remove(&damage->renderer_destroy.link);
+	wl_list_init(&damage->renderer_destroy.link);
+}
+
+static void screencopy_damage_handle_renderer_destroy(
+		struct wl_listener *listener, void *data) {
+	struct screencopy_damage *damage =
+		wl_container_of(listener, damage, renderer_destroy);
+	// The texture needs to be destroyed before its renderer
+	screencopy_damage_release_texture(damage);
+}
+
+static void screencopy_damage_accumulate(struct screencopy_damage *damage,
+		const struct wlr_output_state *state) {
+	damage_region_accumulate(&damage->damage, damage->output, state);
+
+	struct screencopy_buffer *buffer;
+	wl_list_for_each(buffer, &damage->buffers, link) {
+		damage_region_accumulate(&buffer->damage, damage->output, state);
+	}
+
+	if (state->committed & WLR_OUTPUT_STATE_BUFFER) {
+		screencopy_damage_release_texture(damage);
+	}
+}
+
 static void screencopy_damage_handle_output_precommit(
 		struct wl_listener *listener, void *data) {
 	struct screencopy_damage *damage =
@@ -66,7 +124,61 @@ static void screencopy_damage_handle_output_precommit(
 	screencopy_damage_accumulate(damage, event->state);
 }
 
+static void screencopy_buffer_destroy(struct screencopy_buffer *buffer) {
+	wl_list_remove(&buffer->buffer_destroy.link);
+	wl_list_remove(&buffer->link);
+	pixman_region32_fini(&buffer->damage);
+	free(buffer);
+}
+
+static void screencopy_buffer_handle_buffer_destroy(struct wl_listener *listener,
+		void *data) {
+	struct screencopy_buffer *buffer =
+		wl_container_of(listener, buffer, buffer_destroy);
+	screencopy_buffer_destroy(buffer);
+}
+
+static struct screencopy_buffer *screencopy_buffer_get_or_create(
+		struct screencopy_damage *damage, struct wlr_buffer *wlr_buffer) {
+	struct screencopy_buffer *buffer;
+	size_t n_buffers = 0;
+	wl_list_for_each(buffer, &damage->buffers, link) {
+		if (buffer->buffer == wlr_buffer) {
+			// Keep the list in most-recently-used order
+			wl_list_remove(&buffer->link);
+			wl_list_insert(&damage->buffers, &buffer->link);
+			return buffer;
+		}
+		n_buffers++;
+	}
+
+	if (n_buffers >= SCREENCOPY_MAX_BUFFERS) {
+		struct screencopy_buffer *oldest =
+			wl_container_of(damage->buffers.prev, oldest, link);
+		screencopy_buffer_destroy(oldest);
+	}
+
+	buffer = calloc(1, sizeof(*buffer));
+	if (buffer == NULL) {
+		return NULL;
+	}
+
+	buffer->buffer = wlr_buffer;
+	pixman_region32_init(&buffer->damage);
+	wl_list_insert(&damage->buffers, &buffer->link);
+
+	buffer->buffer_destroy.notify = screencopy_buffer_handle_buffer_destroy;
+	wl_signal_add(&wlr_buffer->events.destroy, &buffer->buffer_destroy);
+
+	return buffer;
+}
+
 static void screencopy_damage_destroy(struct screencopy_damage *damage) {
+	struct screencopy_buffer *buffer, *tmp_buffer;
+	wl_list_for_each_safe(buffer, tmp_buffer, &damage->buffers, link) {
+		screencopy_buffer_destroy(buffer);
+	}
+	screencopy_damage_release_texture(damage);
 	wl_list_remove(&damage->output_destroy.link);
 	wl_list_remove(&damage->output_precommit.link);
 	wl_list_remove(&damage->link);
@@ -92,6 +204,7 @@ static struct screencopy_damage *screencopy_damage_create(
 	damage->output = output;
 	pixman_region32_init_rect(&damage->damage, 0, 0, output->width,
 		output->height);
+	wl_list_init(&damage->buffers);
 	wl_list_insert(&client->damages, &damage->link);
 
 	wl_signal_add(&output->events.precommit, &damage->output_precommit);
@@ -101,6 +214,8 @@ static struct screencopy_damage *screencopy_damage_create(
 	wl_signal_add(&output->events.destroy, &damage->output_destroy);
 	damage->output_destroy.notify = screencopy_damage_handle_output_destroy;
 
+	wl_list_init(&damage->renderer_destroy.link);
+
 	return damage;
 }
 
@@ -189,12 +304,62 @@ static void frame_send_ready(struct wlr_screencopy_frame_v1 *frame,
 		tv_sec_hi, tv_sec_lo, when->tv_nsec);
 }
 
-static bool frame_shm_copy(struct wlr_screencopy_frame_v1 *frame,
+static struct wlr_texture *screencopy_damage_get_texture(
+		struct screencopy_damage *damage, struct wlr_renderer *renderer,
 		struct wlr_buffer *src_buffer) {
-	struct wlr_output *output = frame->output;
-	struct wlr_renderer *renderer = output->renderer;
-	assert(renderer);
+	if (damage->texture != NULL && damage->texture_buffer == src_buffer &&
+			damage->texture_renderer == renderer) {
+		return damage->texture;
+	}
+
+	screencopy_damage_release_texture(damage);
 
+	struct wlr_texture *texture = wlr_texture_from_buffer(renderer, src_buffer);
+	if (texture == NULL) {
+		return NULL;
+	}
+
+	damage->texture = texture;
+	damage->texture_buffer = wlr_buffer_lock(src_buffer);
+	damage->texture_renderer = renderer;
+	damage->renderer_destroy.notify = screencopy_damage_handle_renderer_destroy;
+	wl_signal_add(&renderer->events.destroy, &damage->renderer_destroy);
+	return texture;
+}
+
+static bool texture_read_region(struct wlr_texture *texture,
+		const struct pixman_region32 *region, const struct wlr_box *box,
+		void *data, uint32_t format, size_t stride) {
+	int rects_len = 0;
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+	if (rects_len > SCREENCOPY_MAX_DAMAGE_RECTS) {
+		// Fewer larger reads are cheaper than many small ones
+		rects = pixman_region32_extents(region);
+		rects_len = 1;
+	}
+
+	bool ok = true;
+	for (int i = 0; i < rects_len && ok; i++) {
+		const pixman_box32_t *rect = &rects[i];
+		ok = wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options) {
+			.data = data,
+			.format = format,
+			.stride = stride,
+			.dst_x = rect->x1 - box->x,
+			.dst_y = rect->y1 - box->y,
+			.src_box = {
+				.x = rect->x1,
+				.y = rect->y1,
+				.width = rect->x2 - rect->x1,
+				.height = rect->y2 - rect->y1,
+			},
+		});
+	}
+	return ok;
+}
+
+static bool frame_shm_copy(struct wlr_screencopy_frame_v1 *frame,
+		struct wlr_texture *texture, const struct pixman_region32 *region) {
 	void *data;
 	uint32_t format;
 	size_t stride;
@@ -203,51 +368,32 @@ static bool frame_shm_copy(struct wlr_screencopy_frame_v1 *frame,
 		return false;
 	}
 
-	bool ok = false;
+	bool ok = texture_read_region(texture, region, &frame->box,
+		data, format, stride);
 
-	struct wlr_texture *texture = wlr_texture_from_buffer(renderer, src_buffer);
-	if (!texture) {
-		goto out;
-	}
-
-	ok = wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options) {
-		.data = data,
-		.format = format,
-		.stride = stride,
-		.src_box = frame->box,
-	});
-
-	wlr_texture_destroy(texture);
-
-out:
 	wlr_buffer_end_data_ptr_access(frame->buffer);
 	return ok;
 }
 
 static bool frame_dma_copy(struct wlr_screencopy_frame_v1 *frame,
-		struct wlr_buffer *src_buffer) {
+		struct wlr_texture *texture, const struct pixman_region32 *region) {
 	struct wlr_buffer *dst_buffer = frame->buffer;
-	struct wlr_output *output = frame->output;
-	struct wlr_renderer *renderer = output->renderer;
+	struct wlr_renderer *renderer = frame->output->renderer;
 	assert(renderer);
 
-
-	struct wlr_texture *src_tex =
-		wlr_texture_from_buffer(renderer, src_buffer);
-	if (src_tex == NULL) {
-		return false;
-	}
-
-	bool ok = false;
-
 	struct wlr_render_pass *pass =
 		wlr_renderer_begin_buffer_pass(renderer, dst_buffer, NULL);
 	if (!pass) {
-		goto out;
+		return false;
 	}
 
+	struct pixman_region32 clip;
+	pixman_region32_init(&clip);
+	pixman_region32_copy(&clip, region);
+	pixman_region32_translate(&clip, -frame->box.x, -frame->box.y);
+
 	wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options) {
-		.texture = src_tex,
+		.texture = texture,
 		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
 		.dst_box = (struct wlr_box){
 			.width = dst_buffer->width,
@@ -259,13 +405,182 @@ static bool frame_dma_copy(struct wlr_screencopy_frame_v1 *frame,
 			.width = frame->box.width,
 			.height = frame->box.height,
 		},
+		.clip = &clip,
 	});
 
-	ok = wlr_render_pass_submit(pass);
+	pixman_region32_fini(&clip);
+	return wlr_render_pass_submit(pass);
+}
 
-out:
-	wlr_texture_destroy(src_tex);
-	return ok;
+/**
+ * A frame served from the readback performed for another frame.
+ */
+struct screencopy_fanout {
+	struct wlr_screencopy_frame_v1 *frame;
+	struct screencopy_buffer *copy_buffer; // may be NULL
+	struct pixman_region32 region;
+};
+
+static bool frame_has_damage(struct wlr_screencopy_frame_v1 *frame) {
+	if (!frame->with_damage) {
+		return true;
+	}
+	struct screencopy_damage *damage =
+		screencopy_damage_get_or_create(frame->client, frame->output);
+	return damage == NULL || pixman_region32_not_empty(&damage->damage);
+}
+
+/**
+ * Get the region of the output buffer which needs to be copied into the
+ * frame's buffer.
+ */
+static void frame_get_copy_region(struct wlr_screencopy_frame_v1 *frame,
+		struct screencopy_buffer **copy_buffer_ptr,
+		struct pixman_region32 *region) {
+	// Clients using copy_with_damage only need the regions damaged since the
+	// last copy into the same buffer to be read back
+	struct screencopy_buffer *copy_buffer = NULL;
+	if (frame->with_damage) {
+		struct screencopy_damage *damage =
+			screencopy_damage_get_or_create(frame->client, frame->output);
+		if (damage != NULL) {
+			copy_buffer = screencopy_buffer_get_or_create(damage, frame->buffer);
+		}
+	}
+
+	if (copy_buffer != NULL && wlr_box_equal(&copy_buffer->box, &frame->box)) {
+		pixman_region32_init(region);
+		pixman_region32_intersect_rect(region, &copy_buffer->damage,
+			frame->box.x, frame->box.y, frame->box.width, frame->box.height);
+	} else {
+		pixman_region32_init_rect(region,
+			frame->box.x, frame->box.y, frame->box.width, frame->box.height);
+	}
+
+	*copy_buffer_ptr = copy_buffer;
+}
+
+static void frame_finish_copy(struct wlr_screencopy_frame_v1 *frame,
+		struct screencopy_buffer *copy_buffer, bool ok, struct timespec *when) {
+	if (copy_buffer != NULL) {
+		if (ok) {
+			copy_buffer->box = frame->box;
+			pixman_region32_clear(&copy_buffer->damage);
+		} else {
+			// The buffer contents are unknown, do a full copy next time
+			copy_buffer->box = (struct wlr_box){0};
+		}
+	}
+
+	if (ok) {
+		zwlr_screencopy_frame_v1_send_flags(frame->resource, 0);
+		frame_send_damage(frame);
+		frame_send_ready(frame, when);
+	} else {
+		zwlr_screencopy_frame_v1_send_failed(frame->resource);
+	}
+	frame_destroy(frame);
+}
+
+/**
+ * Collect the other shm frames pending on the same output which can be served
+ * from the readback of the given frame, and add their regions to it.
+ */
+static void frame_collect_fanout(struct wlr_screencopy_frame_v1 *frame,
+		struct wl_array *fanout, struct pixman_region32 *region) {
+	struct wlr_screencopy_frame_v1 *peer;
+	wl_list_for_each(peer, &frame->client->manager->frames, link) {
+		if (peer == frame || peer->output != frame->output ||
+				peer->buffer == NULL ||
+				peer->buffer_cap != WLR_BUFFER_CAP_DATA_PTR ||
+				wl_list_empty(&peer->output_commit.link) ||
+				peer->shm_format != frame->shm_format ||
+				peer->shm_stride != frame->shm_stride ||
+				!wlr_box_equal(&peer->box, &frame->box) ||
+				!frame_has_damage(peer)) {
+			continue;
+		}
+
+		struct screencopy_fanout *entry = wl_array_add(fanout, sizeof(*entry));
+		if (entry == NULL) {
+			break;
+		}
+		entry->frame = peer;
+		frame_get_copy_region(peer, &entry->copy_buffer, &entry->region);
+		pixman_region32_union(region, region, &entry->region);
+
+		// The peer is served by this readback
+		wl_list_remove(&peer->output_commit.link);
+		wl_list_init(&peer->output_commit.link);
+	}
+}
+
+/**
+ * A readback of the capture box into compositor memory, shared by several
+ * frames. Client buffers are never used as the source of another client's
+ * frame, since their owner can write to them at any time.
+ */
+struct screencopy_staging {
+	void *data;
+	size_t stride;
+};
+
+static bool frame_staging_read(struct wlr_screencopy_frame_v1 *frame,
+		struct wlr_texture *texture, const struct pixman_region32 *region,
+		struct screencopy_staging *staging) {
+	const struct wlr_pixel_format_info *info =
+		drm_get_pixel_format_info(frame->shm_format);
+	if (info == NULL) {
+		return false;
+	}
+
+	staging->stride = pixel_format_info_min_stride(info, frame->box.width);
+	staging->data = malloc(staging->stride * frame->box.height);
+	if (staging->data == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+
+	if (!texture_read_region(texture, region, &frame->box, staging->data,
+			frame->shm_format, staging->stride)) {
+		free(staging->data);
+		staging->data = NULL;
+		return false;
+	}
+	return true;
+}
+
+static bool frame_copy_from_staging(struct wlr_screencopy_frame_v1 *frame,
+		const struct screencopy_staging *staging,
+		const struct pixman_region32 *region) {
+	const struct wlr_pixel_format_info *info =
+		drm_get_pixel_format_info(frame->shm_format);
+	if (info == NULL) {
+		return false;
+	}
+
+	void *data;
+	uint32_t format;
+	size_t stride;
+	if (!wlr_buffer_begin_data_ptr_access(frame->buffer,
+			WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &data, &format, &stride)) {
+		return false;
+	}
+
+	int rects_len = 0;
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+	for (int i = 0; i < rects_len; i++) {
+		const pixman_box32_t *rect = &rects[i];
+		size_t offset = pixel_format_info_min_stride(info, rect->x1 - frame->box.x);
+		size_t len = pixel_format_info_min_stride(info, rect->x2 - rect->x1);
+		for (int y = rect->y1 - frame->box.y; y < rect->y2 - frame->box.y; y++) {
+			memcpy((char *)data + y * stride + offset,
+				(const char *)staging->data + y * staging->stride + offset, len);
+		}
+	}
+
+	wlr_buffer_end_data_ptr_access(frame->buffer);
+	return true;
 }
 
 static void frame_handle_output_commit(struct wl_listener *listener,
@@ -285,12 +600,8 @@ static void frame_handle_output_commit(struct wl_listener *listener,
 		return;
 	}
 
-	if (frame->with_damage) {
-		struct screencopy_damage *damage =
-			screencopy_damage_get_or_create(frame->client, output);
-		if (damage && !pixman_region32_not_empty(&damage->damage)) {
-			return;
-		}
+	if (!frame_has_damage(frame)) {
+		return;
 	}
 
 	wl_list_remove(&frame->output_commit.link);
@@ -300,33 +611,68 @@ static void frame_handle_output_commit(struct wl_listener *listener,
 	if (frame->box.x < 0 || frame->box.y < 0 ||
 			frame->box.x + frame->box.width > src_buffer->width ||
 			frame->box.y + frame->box.height > src_buffer->height) {
-		goto err;
+		frame_finish_copy(frame, NULL, false, event->when);
+		return;
+	}
+
+	struct screencopy_damage *damage =
+		screencopy_damage_get_or_create(frame->client, output);
+	struct wlr_texture *texture = NULL;
+	if (damage != NULL) {
+		texture = screencopy_damage_get_texture(damage, renderer, src_buffer);
+	}
+	if (texture == NULL) {
+		frame_finish_copy(frame, NULL, false, event->when);
+		return;
+	}
+
+	struct screencopy_buffer *copy_buffer;
+	struct pixman_region32 region;
+	frame_get_copy_region(frame, &copy_buffer, &region);
+
+	// Other clients capturing the same part of the output into shm buffers
+	// are served from a single readback into a staging buffer
+	struct wl_array fanout;
+	wl_array_init(&fanout);
+	struct pixman_region32 read_region;
+	pixman_region32_init(&read_region);
+	pixman_region32_copy(&read_region, &region);
+	if (frame->buffer_cap == WLR_BUFFER_CAP_DATA_PTR) {
+		frame_collect_fanout(frame, &fanout, &read_region);
 	}
 
+	bool ok;
+	struct screencopy_staging staging = {0};
 	switch (frame->buffer_cap) {
 	case WLR_BUFFER_CAP_DMABUF:
-		if (!frame_dma_copy(frame, src_buffer)) {
-			goto err;
-		}
+		ok = frame_dma_copy(frame, texture, &region);
 		break;
 	case WLR_BUFFER_CAP_DATA_PTR:
-		if (!frame_shm_copy(frame, src_buffer)) {
-			goto err;
+		if (fanout.size == 0) {
+			ok = frame_shm_copy(frame, texture, &region);
+			break;
 		}
+		ok = frame_staging_read(frame, texture, &read_region, &staging) &&
+			frame_copy_from_staging(frame, &staging, &region);
 		break;
 	default:
 		abort(); // unreachable
 	}
+	pixman_region32_fini(&read_region);
+	pixman_region32_fini(&region);
+
+	struct screencopy_fanout *entry;
+	wl_array_for_each(entry, &fanout) {
+		bool entry_ok = staging.data != NULL &&
+			frame_copy_from_staging(entry->frame, &staging, &entry->region);
+		pixman_region32_fini(&entry->region);
+		frame_finish_copy(entry->frame, entry->copy_buffer, entry_ok,
+			event->when);
+	}
+	wl_array_release(&fanout);
+	free(staging.data);
 
-	zwlr_screencopy_frame_v1_send_flags(frame->resource, 0);
-	frame_send_damage(frame);
-	frame_send_ready(frame, event->when);
-	frame_destroy(frame);
-	return;
-
-err:
-	zwlr_screencopy_frame_v1_send_failed(frame->resource);
-	frame_destroy(frame);
+	frame_finish_copy(frame, copy_buffer, ok, event->when);
 }
 
 static void frame_handle_output_enable(struct wl_listener *listener,
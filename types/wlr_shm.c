@@ -23,9 +23,26 @@
 
 #define SHM_VERSION 1
 
+/**
+ * Per-client accounting of the memory mapped for wl_shm_pools.
+ *
+ * Pools can outlive their client (buffers may still be locked by the
+ * compositor), so this struct is kept alive until the last pool is destroyed.
+ */
+struct wlr_shm_client {
+	struct wlr_shm *shm; // NULL if the wlr_shm has been destroyed
+	struct wl_client *client; // NULL if the client has been destroyed
+	size_t mapped_size;
+	size_t n_pools;
+	struct wl_list link; // wlr_shm.clients
+
+	struct wl_listener client_destroy;
+};
+
 struct wlr_shm_pool {
 	struct wl_resource *resource; // may be NULL
 	struct wlr_shm *shm;
+	struct wlr_shm_client *owner;
 	struct wl_list buffers; // wlr_shm_buffer.link
 	int fd;
 	struct wlr_shm_mapping *mapping;
@@ -97,6 +114,86 @@ static struct wlr_shm *shm_from_resource(struct wl_resource *resource) {
 	return wl_resource_get_user_data(resource);
 }
 
+static void shm_client_handle_client_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_shm_client *shm_client =
+		wl_container_of(listener, shm_client, client_destroy);
+	// Pools may still be referenced by buffers, keep the accounting around
+	// but make sure a new client re-using the same address won't match
+	shm_client->client = NULL;
+	wl_list_remove(&shm_client->client_destroy.link);
+	wl_list_init(&shm_client->client_destroy.link);
+}
+
+static struct wlr_shm_client *shm_client_find(struct wlr_shm *shm,
+		struct wl_client *client) {
+	struct wlr_shm_client *shm_client;
+	wl_list_for_each(shm_client, &shm->clients, link) {
+		if (shm_client->client == client) {
+			return shm_client;
+		}
+	}
+	return NULL;
+}
+
+static struct wlr_shm_client *shm_client_get_or_create(struct wlr_shm *shm,
+		struct wl_client *client) {
+	struct wlr_shm_client *shm_client = shm_client_find(shm, client);
+	if (shm_client != NULL) {
+		return shm_client;
+	}
+
+	shm_client = calloc(1, sizeof(*shm_client));
+	if (shm_client == NULL) {
+		return NULL;
+	}
+
+	shm_client->shm = shm;
+	shm_client->client = client;
+	shm_client->client_destroy.notify = shm_client_handle_client_destroy;
+	wl_client_add_destroy_listener(client, &shm_client->client_destroy);
+	wl_list_insert(&shm->clients, &shm_client->link);
+	return shm_client;
+}
+
+static void shm_client_consider_destroy(struct wlr_shm_client *shm_client) {
+	if (shm_client->n_pools > 0) {
+		return;
+	}
+
+	assert(shm_client->mapped_size == 0);
+	wl_list_remove(&shm_client->client_destroy.link);
+	wl_list_remove(&shm_client->link);
+	free(shm_client);
+}
+
+/**
+ * Check whether the client is allowed to map size more bytes. Emits the
+ * quota_exceeded signal if not.
+ */
+static bool shm_client_check_quota(struct wlr_shm_client *shm_client,
+		size_t size) {
+	struct wlr_shm *shm = shm_client->shm;
+	if (shm == NULL || shm->client_quota == 0 ||
+			(shm_client->mapped_size <= shm->client_quota &&
+			size <= shm->client_quota - shm_client->mapped_size)) {
+		return true;
+	}
+
+	wlr_log(WLR_DEBUG, "Client exceeded wl_shm quota "
+		"(%zu bytes mapped, %zu requested, %zu allowed)",
+		shm_client->mapped_size, size, shm->client_quota);
+
+	struct wlr_shm_quota_exceeded_event event = {
+		.client = shm_client->client,
+		.mapped_size = shm_client->mapped_size,
+		.requested_size = size,
+		.quota = shm->client_quota,
+	};
+	wl_signal_emit_mutable(&shm->events.quota_exceeded, &event);
+	return false;
+}
+
 static struct wlr_shm_mapping *mapping_create(int fd, size_t size) {
 	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 	if (data == MAP_FAILED) {
@@ -379,6 +476,13 @@ static void pool_handle_resize(struct wl_client *client,
 		return;
 	}
 
+	size_t old_size = pool->mapping->size;
+	if (!shm_client_check_quota(pool->owner, (size_t)size - old_size)) {
+		wl_resource_post_error(pool_resource, WL_SHM_ERROR_INVALID_FD,
+			"Resizing the pool to %d bytes exceeds the client quota", size);
+		return;
+	}
+
 	struct wlr_shm_mapping *mapping = mapping_create(pool->fd, size);
 	if (mapping == NULL) {
 		wl_resource_post_error(pool_resource, WL_SHM_ERROR_INVALID_FD,
@@ -388,6 +492,8 @@ static void pool_handle_resize(struct wl_client *client,
 
 	mapping_drop(pool->mapping);
 	pool->mapping = mapping;
+
+	pool->owner->mapped_size += mapping->size - old_size;
 }
 
 static const struct wl_shm_pool_interface pool_impl = {
@@ -401,6 +507,10 @@ static void pool_consider_destroy(struct wlr_shm_pool *pool) {
 		return;
 	}
 
+	pool->owner->mapped_size -= pool->mapping->size;
+	pool->owner->n_pools--;
+	shm_client_consider_destroy(pool->owner);
+
 	mapping_drop(pool->mapping);
 	close(pool->fd);
 	free(pool);
@@ -422,11 +532,22 @@ static void shm_handle_create_pool(struct wl_client *client,
 		goto error_fd;
 	}
 
+	struct wlr_shm_client *owner = shm_client_get_or_create(shm, client);
+	if (owner == NULL) {
+		wl_resource_post_no_memory(shm_resource);
+		goto error_fd;
+	}
+	if (!shm_client_check_quota(owner, size)) {
+		wl_resource_post_error(shm_resource, WL_SHM_ERROR_INVALID_FD,
+			"Creating a pool of %d bytes exceeds the client quota", size);
+		goto error_owner;
+	}
+
 	struct wlr_shm_mapping *mapping = mapping_create(fd, size);
 	if (mapping == NULL) {
 		wl_resource_post_error(shm_resource, WL_SHM_ERROR_INVALID_FD,
 			"Failed to create memory mapping");
-		goto error_fd;
+		goto error_owner;
 	}
 
 	struct wlr_shm_pool *pool = calloc(1, sizeof(*pool));
@@ -449,12 +570,18 @@ static void shm_handle_create_pool(struct wl_client *client,
 	pool->shm = shm;
 	pool->fd = fd;
 	wl_list_init(&pool->buffers);
+
+	pool->owner = owner;
+	owner->n_pools++;
+	owner->mapped_size += mapping->size;
 	return;
 
 error_pool:
 	free(pool);
 error_mapping:
 	mapping_drop(mapping);
+error_owner:
+	shm_client_consider_destroy(owner);
 error_fd:
 	close(fd);
 }
@@ -482,6 +609,15 @@ static void shm_bind(struct wl_client *client, void *data, uint32_t version,
 
 static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_shm *shm = wl_container_of(listener, shm, display_destroy);
+
+	// Pools may outlive the global, detach their accounting from it
+	struct wlr_shm_client *shm_client, *tmp;
+	wl_list_for_each_safe(shm_client, tmp, &shm->clients, link) {
+		shm_client->shm = NULL;
+		wl_list_remove(&shm_client->link);
+		wl_list_init(&shm_client->link);
+	}
+
 	wl_list_remove(&shm->display_destroy.link);
 	wl_global_destroy(shm->global);
 	free(shm->formats);
@@ -521,6 +657,9 @@ struct wlr_shm *wlr_shm_create(struct wl_display *display, uint32_t version,
 		shm->formats[i] = convert_drm_format_to_wl_shm(formats[i]);
 	}
 
+	wl_signal_init(&shm->events.quota_exceeded);
+	wl_list_init(&shm->clients);
+
 	shm->global = wl_global_create(display, &wl_shm_interface, SHM_VERSION,
 		shm, shm_bind);
 	if (shm->global == NULL) {
@@ -560,3 +699,15 @@ static bool shm_has_format(struct wlr_shm *shm, uint32_t shm_format) {
 	}
 	return false;
 }
+
+void wlr_shm_set_client_quota(struct wlr_shm *shm, size_t quota) {
+	shm->client_quota = quota;
+}
+
+size_t wlr_shm_get_client_usage(struct wlr_shm *shm, struct wl_client *client) {
+	struct wlr_shm_client *shm_client = shm_client_find(shm, client);
+	if (shm_client == NULL) {
+		return 0;
+	}
+	return shm_client->mapped_size;
+}
@@ -1,4 +1,7 @@
+#undef _POSIX_C_SOURCE
+#define _GNU_SOURCE // for F_SETPIPE_SZ
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
@@ -81,20 +84,6 @@ static bool xwm_selection_transfer_get_incoming_selection_property(
 	return true;
 }
 
-static void xwm_notify_ready_for_next_incr_chunk(
-		struct wlr_xwm_selection_transfer *transfer) {
-	struct wlr_xwm *xwm = transfer->selection->xwm;
-	assert(transfer->incr);
-
-	wlr_log(WLR_DEBUG, "deleting property");
-	xcb_delete_property(xwm->xcb_conn, transfer->incoming_window,
-		xwm->atoms[WL_SELECTION]);
-	xcb_flush(xwm->xcb_conn);
-
-	xwm_selection_transfer_remove_event_source(transfer);
-	xwm_selection_transfer_destroy_property_reply(transfer);
-}
-
 /**
  * Write the X11 selection to a Wayland client. Returns a nonzero value if the
  * Wayland client might become writeable again in the future.
@@ -122,25 +111,15 @@ static int write_selection_property_to_wl_client(int fd, uint32_t mask,
 	if (len < remainder) {
 		transfer->property_start += len;
 		return 1;
-	} else if (transfer->incr) {
-		xwm_notify_ready_for_next_incr_chunk(transfer);
-	} else {
-		wlr_log(WLR_DEBUG, "transfer complete");
-		xwm_selection_transfer_destroy(transfer);
 	}
 
+	wlr_log(WLR_DEBUG, "transfer complete");
+	xwm_selection_transfer_destroy(transfer);
 	return 0;
 }
 
 static void xwm_write_selection_property_to_wl_client(
 		struct wlr_xwm_selection_transfer *transfer) {
-	if (transfer->incr && transfer->wl_client_fd < 0) {
-		// Wayland client closed its pipe prematurely before the X11 client finished
-		// its incremental transfer. Continue draining the X11 client.
-		xwm_notify_ready_for_next_incr_chunk(transfer);
-		return;
-	}
-
 	bool wl_client_finished_consuming = !write_selection_property_to_wl_client(
 			transfer->wl_client_fd, WL_EVENT_WRITABLE, transfer);
 	if (!wl_client_finished_consuming) {
@@ -155,24 +134,110 @@ static void xwm_write_selection_property_to_wl_client(
 	}
 }
 
+static void xwm_flush_incr_data(struct wlr_xwm_selection_transfer *transfer);
+
+static int write_incr_data_to_wl_client(int fd, uint32_t mask, void *data) {
+	struct wlr_xwm_selection_transfer *transfer = data;
+	xwm_flush_incr_data(transfer);
+	return 0;
+}
+
+/**
+ * Write the buffered chunks of an incremental transfer to the Wayland client,
+ * then fetch the next chunk if it was held back for lack of buffer space.
+ */
+static void xwm_flush_incr_data(struct wlr_xwm_selection_transfer *transfer) {
+	struct wl_array *buf = &transfer->source_data;
+	int fd = transfer->wl_client_fd;
+
+	while (fd >= 0 && (size_t)transfer->property_start < buf->size) {
+		ssize_t len = write(fd, (char *)buf->data + transfer->property_start,
+			buf->size - transfer->property_start);
+		if (len == -1) {
+			if (errno == EAGAIN) {
+				break;
+			}
+			// Continue draining the X11 client
+			wlr_log_errno(WLR_ERROR, "write error to target fd %d", fd);
+			xwm_selection_transfer_remove_event_source(transfer);
+			xwm_selection_transfer_close_wl_client_fd(transfer);
+			fd = -1;
+			break;
+		}
+		transfer->property_start += len;
+	}
+
+	if (fd < 0 || (size_t)transfer->property_start == buf->size) {
+		buf->size = 0;
+		transfer->property_start = 0;
+	}
+	size_t buffered = buf->size - transfer->property_start;
+
+	if (buffered > 0) {
+		if (transfer->event_source == NULL) {
+			struct wl_event_loop *loop = wl_display_get_event_loop(
+				transfer->selection->xwm->xwayland->wl_display);
+			transfer->event_source = wl_event_loop_add_fd(loop, fd,
+				WL_EVENT_WRITABLE, write_incr_data_to_wl_client, transfer);
+		}
+	} else {
+		xwm_selection_transfer_remove_event_source(transfer);
+		if (transfer->incr_done) {
+			wlr_log(WLR_DEBUG, "incremental transfer complete");
+			xwm_selection_transfer_destroy(transfer);
+			return;
+		}
+	}
+
+	if (transfer->incr_chunk_pending && buffered < INCR_MAX_BUFFERED_SIZE) {
+		transfer->incr_chunk_pending = false;
+		xwm_get_incr_chunk(transfer);
+	}
+}
+
 void xwm_get_incr_chunk(struct wlr_xwm_selection_transfer *transfer) {
 	wlr_log(WLR_DEBUG, "xwm_get_incr_chunk");
 
-	if (transfer->property_reply) {
-		wlr_log(WLR_ERROR, "X11 client offered a new property before we deleted");
+	struct wl_array *buf = &transfer->source_data;
+	if (buf->size - transfer->property_start >= INCR_MAX_BUFFERED_SIZE) {
+		// The X11 client waits for the property to be deleted before sending
+		// the next chunk
+		transfer->incr_chunk_pending = true;
 		return;
 	}
 
-	if (!xwm_selection_transfer_get_incoming_selection_property(transfer, false)) {
+	// Deleting the property right away lets the X11 client prepare the next
+	// chunk while this one is written to the Wayland client
+	if (!xwm_selection_transfer_get_incoming_selection_property(transfer, true)) {
 		return;
 	}
 
-	if (xcb_get_property_value_length(transfer->property_reply) > 0) {
-		xwm_write_selection_property_to_wl_client(transfer);
-	} else {
-		wlr_log(WLR_DEBUG, "incremental transfer complete");
-		xwm_selection_transfer_destroy(transfer);
+	int len = xcb_get_property_value_length(transfer->property_reply);
+	if (len == 0) {
+		transfer->incr_done = true;
+	} else if (transfer->wl_client_fd >= 0) {
+		// Reclaim the space of the data already written, once it's larger
+		// than the data left
+		size_t buffered = buf->size - transfer->property_start;
+		if (transfer->property_start > 0 &&
+				(size_t)transfer->property_start >= buffered) {
+			memmove(buf->data, (char *)buf->data + transfer->property_start,
+				buffered);
+			buf->size = buffered;
+			transfer->property_start = 0;
+		}
+
+		void *dst = wl_array_add(buf, len);
+		if (dst == NULL) {
+			wlr_log(WLR_ERROR, "Could not allocate selection data");
+			xwm_selection_transfer_destroy(transfer);
+			return;
+		}
+		memcpy(dst, xcb_get_property_value(transfer->property_reply), len);
 	}
+	xwm_selection_transfer_destroy_property_reply(transfer);
+
+	xwm_flush_incr_data(transfer);
 }
 
 static void xwm_selection_transfer_get_data(
@@ -237,6 +302,11 @@ static void source_send(struct wlr_xwm_selection *selection,
 	xcb_flush(xwm->xcb_conn);
 
 	fcntl(fd, F_SETFL, O_WRONLY | O_NONBLOCK);
+#ifdef F_SETPIPE_SZ
+	// Let the Wayland client's pipe hold a full chunk, to reduce the number
+	// of wakeups. This fails harmlessly if fd isn't a pipe.
+	fcntl(fd, F_SETPIPE_SZ, INCR_MAX_CHUNK_SIZE);
+#endif
 	transfer->wl_client_fd = fd;
 }
 
@@ -72,8 +72,8 @@ static int xwm_data_source_read(int fd, uint32_t mask, void *data) {
 
 	void *p;
 	size_t current = transfer->source_data.size;
-	if (transfer->source_data.size < INCR_CHUNK_SIZE) {
-		p = wl_array_add(&transfer->source_data, INCR_CHUNK_SIZE);
+	if (transfer->source_data.size < transfer->chunk_size) {
+		p = wl_array_add(&transfer->source_data, transfer->chunk_size);
 		if (p == NULL) {
 			wlr_log(WLR_ERROR, "Could not allocate selection source_data");
 			goto error_out;
@@ -93,7 +93,7 @@ static int xwm_data_source_read(int fd, uint32_t mask, void *data) {
 		available, mask);
 
 	transfer->source_data.size = current + len;
-	if (transfer->source_data.size >= INCR_CHUNK_SIZE) {
+	if (transfer->source_data.size >= transfer->chunk_size) {
 		if (!transfer->incr) {
 			wlr_log(WLR_DEBUG, "got %zu bytes, starting incr",
 				transfer->source_data.size);
@@ -153,11 +153,38 @@ error_out:
 	return 0;
 }
 
+static void xwm_selection_transfer_grow_chunk_size(
+		struct wlr_xwm_selection_transfer *transfer) {
+	struct wlr_xwm *xwm = transfer->selection->xwm;
+
+	// Reads can fill the buffer up to four times the chunk size before the
+	// property is set, make sure it still fits in a ChangeProperty request
+	size_t max_request_size =
+		(size_t)xcb_get_maximum_request_length(xwm->xcb_conn) * 4 - 64;
+	size_t max_chunk_size = INCR_MAX_CHUNK_SIZE;
+	if (max_chunk_size > max_request_size / 4) {
+		max_chunk_size = max_request_size / 4;
+	}
+
+	if (transfer->chunk_size * 2 <= max_chunk_size) {
+		transfer->chunk_size *= 2;
+		wlr_log(WLR_DEBUG, "increasing chunk size to %zu bytes",
+			transfer->chunk_size);
+	}
+}
+
 void xwm_send_incr_chunk(struct wlr_xwm_selection_transfer *transfer) {
 	wlr_log(WLR_DEBUG, "property deleted");
 
 	transfer->property_set = false;
 	if (transfer->flush_property_on_delete) {
+		if (transfer->wl_client_fd >= 0 &&
+				transfer->source_data.size >= transfer->chunk_size) {
+			// The Wayland client produces data faster than the X11 client
+			// consumes it, use larger chunks to save round trips
+			xwm_selection_transfer_grow_chunk_size(transfer);
+		}
+
 		wlr_log(WLR_DEBUG, "setting new property, %zu bytes",
 			transfer->source_data.size);
 		transfer->flush_property_on_delete = false;
@@ -277,6 +304,7 @@ static bool xwm_selection_send_data(struct wlr_xwm_selection *selection,
 
 	xwm_selection_transfer_init(transfer, selection);
 	transfer->request = *req;
+	transfer->chunk_size = INCR_CHUNK_SIZE;
 	wl_array_init(&transfer->source_data);
 
 	int p[2];
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <wlr/types/wlr_clipboard_cache.h>
 #include <wlr/types/wlr_data_device.h>
 #include <wlr/util/log.h>
 #include <xcb/xfixes.h>
@@ -48,6 +49,7 @@ void xwm_selection_transfer_destroy(
 	xwm_selection_transfer_destroy_property_reply(transfer);
 	xwm_selection_transfer_remove_event_source(transfer);
 	xwm_selection_transfer_close_wl_client_fd(transfer);
+	wl_array_release(&transfer->source_data);
 
 	if (transfer->incoming_window) {
 		struct wlr_xwm *xwm = transfer->selection->xwm;
@@ -288,8 +290,13 @@ static void handle_seat_set_selection(struct wl_listener *listener,
 		wl_container_of(listener, xwm, seat_set_selection);
 	struct wlr_data_source *source = seat->selection_source;
 
-	if (source != NULL && data_source_is_xwayland(source)) {
-		return;
+	if (source != NULL) {
+		// The selection may be an X11 source cached by the compositor
+		struct wlr_data_source *origin =
+			wlr_clipboard_cache_source_get_origin(source);
+		if (origin != NULL && data_source_is_xwayland(origin)) {
+			return;
+		}
 	}
 
 	xwm_selection_set_owner(&xwm->clipboard_selection, source != NULL);
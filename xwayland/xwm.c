@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <wlr/config.h>
+#include <wlr/types/wlr_clipboard_cache.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_data_device.h>
 #include <wlr/types/wlr_primary_selection.h>
@@ -1864,8 +1865,13 @@ void xwm_destroy(struct wlr_xwm *xwm) {
 	xwm_selection_finish(&xwm->dnd_selection);
 
 	if (xwm->seat) {
-		if (xwm->seat->selection_source &&
-				data_source_is_xwayland(xwm->seat->selection_source)) {
+		struct wlr_data_source *selection_origin = NULL;
+		if (xwm->seat->selection_source != NULL) {
+			selection_origin = wlr_clipboard_cache_source_get_origin(
+				xwm->seat->selection_source);
+		}
+		if (selection_origin != NULL &&
+				data_source_is_xwayland(selection_origin)) {
 			wlr_seat_set_selection(xwm->seat, NULL,
 				wl_display_next_serial(xwm->xwayland->wl_display));
 		}